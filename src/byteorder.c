@@ -0,0 +1,39 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "byteorder.h"
+
+
+/*  Store value in the nbytes bytes at p, least significant first  */
+void putLE (unsigned char *p, unsigned long long value, unsigned int nbytes) {
+  unsigned int i = 0;
+
+  for (i = 0; i < nbytes; i++) {
+    p[i] = (unsigned char) (value & 0xFF);
+    value = value >> 8;
+  }
+
+  return;
+}
+
+
+/*  The value of the nbytes bytes at p, least significant first  */
+unsigned long long getLE (const unsigned char *p, unsigned int nbytes) {
+  unsigned long long value = 0;
+  unsigned int i = 0;
+
+  for (i = nbytes; i != 0; i--) {
+    value = (value << 8) | (unsigned long long) p[i - 1];
+  }
+
+  return (value);
+}
+
+
+/*  Whether the host stores the most significant byte first  */
+bool bigEndian (void) {
+  const unsigned int one = 1;
+
+  return ((*((const unsigned char*) &one) == 1) ? false : true);
+}
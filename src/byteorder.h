@@ -0,0 +1,11 @@
+#ifndef BYTEORDER_H
+#define BYTEORDER_H
+
+/*  The headers of the files of an encoding, and all of a container,
+**  are little-endian whatever the host.  These read and write values
+**  of nbytes (at most 8) bytes in that order.  */
+void putLE (unsigned char *p, unsigned long long value, unsigned int nbytes);
+unsigned long long getLE (const unsigned char *p, unsigned int nbytes);
+bool bigEndian (void);
+
+#endif
@@ -1,31 +1,196 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
 #include <limits.h>
+#include <stdbool.h>
+#if defined (__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "common-def.h"
 #include "ustring.h"
 #include "casefold.h"
 
+#if defined (__SSE2__)
+/*
+**  Vector kernels.  A register holds CASEFOLD_MASKLEN bytes, so the
+**  case of the part of a word covered by the modifier is found with
+**  one range compare and movemask, and changed by flipping 0x20 in
+**  the selected bytes.  The program never calls setlocale (), so
+**  isupper () and toupper () only concern 'A'-'Z' and 'a'-'z'.  Since
+**  both ends of each range are below 0x80, signed compares are safe.
+*/
+
+/*  Bytes of V in the 26 letters from LO  */
+#define CASE_RANGE(V,LO) \
+  _mm_and_si128 (_mm_cmpgt_epi8 (V, _mm_set1_epi8 ((char) ((LO) - 1))), _mm_cmpgt_epi8 (_mm_set1_epi8 ((char) ((LO) + 26)), V))
+
+/*  Flip the case of the bytes of V selected by SEL  */
+#define CASE_FLIP(V,SEL) _mm_xor_si128 (V, _mm_and_si128 (SEL, _mm_set1_epi8 (0x20)))
+
+/*  Copy len (< 16) bytes with at most two fixed-size, possibly
+**  overlapping, moves each, which avoids a call to memcpy ()  */
+static void copyShort (unsigned char *dst, const unsigned char *src, unsigned int len) {
+  if (len >= 8) {
+    memcpy (dst, src, 8);
+    memcpy (dst + len - 8, src + len - 8, 8);
+  }
+  else if (len >= 4) {
+    memcpy (dst, src, 4);
+    memcpy (dst + len - 4, src + len - 4, 4);
+  }
+  else if (len >= 2) {
+    memcpy (dst, src, 2);
+    memcpy (dst + len - 2, src + len - 2, 2);
+  }
+  else if (len == 1) {
+    dst[0] = src[0];
+  }
+}
+
+
+/*  Load the len bytes at p (all 16 if len is at least 16), with
+**  zeroes after them  */
+static __m128i loadChunk (const unsigned char *p, unsigned int len) {
+  unsigned char buf[CASEFOLD_MASKLEN];
+
+  if (len >= CASEFOLD_MASKLEN) {
+    return (_mm_loadu_si128 ((const __m128i*) p));
+  }
+  memset (buf, 0, sizeof (buf));
+  copyShort (buf, p, len);
+  return (_mm_loadu_si128 ((const __m128i*) buf));
+}
+
+
+/*  Store the first len bytes of v (all 16 if len is at least 16)  */
+static void storeChunk (unsigned char *p, unsigned int len, __m128i v) {
+  unsigned char buf[CASEFOLD_MASKLEN];
+
+  if (len >= CASEFOLD_MASKLEN) {
+    _mm_storeu_si128 ((__m128i*) p, v);
+    return;
+  }
+  _mm_storeu_si128 ((__m128i*) buf, v);
+  copyShort (p, buf, len);
+}
+
+
 unsigned int casefold (unsigned char *wrd, unsigned int wrd_len) {
   unsigned int modifier = 0;
   unsigned int i = 0;
   unsigned int count = 0;
+  unsigned int mask = 0;
+  bool beyond = false;
+  __m128i v;
+  __m128i upper;
 
-  if (wrd_len > MAXCASEFOLDLEN) {
-    fprintf (stderr, "casefold:  ");
-    uprintf (stderr, wrd, wrd_len);
-    fprintf (stderr, " (%u)\n", wrd_len);
-    fprintf (stderr, "Word length out of range for case folding (%s, line %u).", __FILE__, __LINE__);
-    exit (EXIT_FAILURE);
+  v = loadChunk (wrd, wrd_len);
+  upper = CASE_RANGE (v, 'A');
+  modifier = (unsigned int) _mm_movemask_epi8 (upper);
+  count = (unsigned int) __builtin_popcount (modifier);
+
+  /*  The common case:  the whole word fits in one register  */
+  if (wrd_len <= CASEFOLD_MASKLEN) {
+    if (count != 0) {
+      storeChunk (wrd, wrd_len, CASE_FLIP (v, upper));
+    }
+    /*  Everything in uppercase, so set top bit  */
+    if (count == wrd_len) {
+      modifier = ALL_CAPS;
+    }
+    return (modifier);
+  }
+
+  for (i = CASEFOLD_MASKLEN; i < wrd_len; i += CASEFOLD_MASKLEN) {
+    mask = (unsigned int) _mm_movemask_epi8 (CASE_RANGE (loadChunk (wrd + i, wrd_len - i), 'A'));
+    if (mask != 0) {
+      count += (unsigned int) __builtin_popcount (mask);
+      beyond = true;
+    }
+  }
+
+  if (count == wrd_len) {
+    modifier = ALL_CAPS;
+  }
+  else if (beyond == true) {
+    /*  An uppercase character beyond the mask needs a pattern  */
+    return (CASEFOLD_PATTERN);
+  }
+
+  if (count != 0) {
+    for (i = 0; i < wrd_len; i += CASEFOLD_MASKLEN) {
+      v = loadChunk (wrd + i, wrd_len - i);
+      storeChunk (wrd + i, wrd_len - i, CASE_FLIP (v, CASE_RANGE (v, 'A')));
+    }
+  }
+
+  return (modifier);
+}
+
+
+void uncasefold (unsigned char *wrd, unsigned int wrd_len, unsigned int modifier) {
+  unsigned int i = 0;
+  __m128i v;
+  __m128i sel;
+  __m128i bits;
+
+  /*  Top bit set so everything is in uppercase  */
+  if (modifier == ALL_CAPS) {
+    for (i = 0; i < wrd_len; i += CASEFOLD_MASKLEN) {
+      v = loadChunk (wrd + i, wrd_len - i);
+      storeChunk (wrd + i, wrd_len - i, CASE_FLIP (v, CASE_RANGE (v, 'a')));
+    }
+    return;
+  }
+
+  if ((modifier == 0) || (wrd_len == 0)) {
+    return;
+  }
+
+  /*  Spread the mask so that byte i holds byte i / 8 of it, then
+  **  keep the bytes whose own bit is set  */
+  sel = _mm_cvtsi32_si128 ((int) (modifier & 0xFFFF));
+  sel = _mm_unpacklo_epi8 (sel, sel);
+  sel = _mm_unpacklo_epi16 (sel, sel);
+  sel = _mm_unpacklo_epi32 (sel, sel);
+  bits = _mm_set_epi8 ((char) 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01, (char) 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+  sel = _mm_cmpeq_epi8 (_mm_and_si128 (sel, bits), bits);
+
+  v = loadChunk (wrd, wrd_len);
+  storeChunk (wrd, wrd_len, CASE_FLIP (v, _mm_and_si128 (sel, CASE_RANGE (v, 'a'))));
+
+  return;
+}
+
+#else
+
+unsigned int casefold (unsigned char *wrd, unsigned int wrd_len) {
+  unsigned int modifier = 0;
+  unsigned int i = 0;
+  unsigned int count = 0;
+
+  /*  An uppercase character beyond the mask needs a pattern, unless
+  **  the whole word is in uppercase  */
+  for (i = CASEFOLD_MASKLEN; i < wrd_len; i++) {
+    if (isupper (wrd[i])) {
+      for (i = 0; i < wrd_len; i++) {
+        if (!isupper (wrd[i])) {
+          return (CASEFOLD_PATTERN);
+        }
+      }
+      break;
+    }
   }
 
   for (i = (wrd_len - 1); i != UINT_MAX; i--) {
-    modifier = modifier << 1;
     if (isupper (wrd[i])) {
       count++;
+      if (i < CASEFOLD_MASKLEN) {
+        modifier = modifier | (0x1U << i);
+      }
       wrd[i] = (unsigned char) tolower (wrd[i]);
-      modifier = modifier | 0x1;
     }
   }
 
@@ -62,3 +227,40 @@ void uncasefold (unsigned char *wrd, unsigned int wrd_len, unsigned int modifier
 
   return;
 }
+
+#endif
+
+
+/*
+**  Case-fold a word for which casefold returned CASEFOLD_PATTERN and
+**  write the pattern of its case to pattern (CASEFOLD_PATTERN_MAX
+**  bytes).  Returns the length of the pattern.
+*/
+unsigned int casefoldPattern (unsigned char *wrd, unsigned int wrd_len, unsigned char *pattern) {
+  unsigned int pattern_len = 0;
+  unsigned int i = 0;
+
+  memset (pattern, 0, (size_t) CASEFOLD_PATTERN_MAX);
+  for (i = 0; i < wrd_len; i++) {
+    if (isupper (wrd[i])) {
+      pattern[i >> 3] = pattern[i >> 3] | (unsigned char) (0x1U << (i & 0x7));
+      pattern_len = (i >> 3) + 1;
+      wrd[i] = (unsigned char) tolower (wrd[i]);
+    }
+  }
+
+  return (pattern_len);
+}
+
+
+void uncasefoldPattern (unsigned char *wrd, unsigned int wrd_len, const unsigned char *pattern, unsigned int pattern_len) {
+  unsigned int i = 0;
+
+  for (i = 0; (i < wrd_len) && ((i >> 3) < pattern_len); i++) {
+    if ((pattern[i >> 3] & (0x1U << (i & 0x7))) != 0) {
+      wrd[i] = (unsigned char) toupper (wrd[i]);
+    }
+  }
+
+  return;
+}
@@ -4,12 +4,28 @@
 #define ALL_CAPS 0x10000                    /*  65,536 or (1 << 16)  */
 
 
-/*  Maximum length of string that can be case-folded depends on
-**  the size of an unsigned integer.  However, in word-based
-**  Re-Pair, the maximum length with be far shorter  */
-#define MAXCASEFOLDLEN 32
+/*  The modifier records the case of the first CASEFOLD_MASKLEN
+**  characters of a word as a bit mask (bit i for position i), or is
+**  ALL_CAPS if every character is in uppercase.  */
+#define CASEFOLD_MASKLEN 16
+
+/*  A word with an uppercase character beyond the mask which is not
+**  entirely in uppercase is left as it is by casefold, which returns
+**  CASEFOLD_PATTERN.  casefoldPattern then folds it and records its
+**  case as a pattern of CASEFOLD_PATTERN_MAX bytes at most:  bit j of
+**  byte i is set if position 8i + j was in uppercase, and the pattern
+**  ends at its last non-zero byte.  The encoder keeps the distinct
+**  patterns in a table (".cfx") and gives such a word the modifier
+**  CASEFOLD_PATTERN plus the id of its pattern.  uncasefold must not
+**  be given these modifiers; uncasefoldPattern takes the pattern.
+**  A pattern covers words of up to 8 * CASEFOLD_PATTERN_MAX (256)
+**  characters.  */
+#define CASEFOLD_PATTERN 0x20000
+#define CASEFOLD_PATTERN_MAX 32
 
 unsigned int casefold (unsigned char *wrd, unsigned int wrd_len);
 void uncasefold (unsigned char *wrd, unsigned int wrd_len, unsigned int modifier);
+unsigned int casefoldPattern (unsigned char *wrd, unsigned int wrd_len, unsigned char *pattern);
+void uncasefoldPattern (unsigned char *wrd, unsigned int wrd_len, const unsigned char *pattern, unsigned int pattern_len);
 
 #endif
@@ -0,0 +1,272 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "common-def.h"
+#include "ustring.h"
+#include "wmalloc.h"
+#include "prepair-defn.h"
+#include "fcode.h"
+#include "word.h"
+#include "nonword.h"
+#include "prepair.h"
+#include "modseq.h"
+#include "byteorder.h"
+#include "container.h"
+
+/*  The files which are packed, in the order of their sections, and
+**  what each holds.  The rest are optional:  the patterns of case,
+**  if there are any, and the surface forms, which are only packed
+**  together.  */
+enum PARTKIND { PART_DICT = 0, PART_SYMSEQ = 1, PART_MODSEQ = 2 };
+#define NUM_PARTS 9
+#define NUM_REQUIRED_PARTS 6
+#define PART_CFX 6
+#define PART_SRF 7
+#define PART_SS 8
+static const char *part_exts[NUM_PARTS] = { "wd", "ws", "nwd", "nws", "cfm", "sm", "cfx", "srf", "ss" };
+static const enum PARTKIND part_kinds[NUM_PARTS] = { PART_DICT, PART_SYMSEQ, PART_DICT, PART_SYMSEQ, PART_MODSEQ, PART_MODSEQ, PART_DICT, PART_DICT, PART_SYMSEQ };
+
+
+/*  Copy the n unsigned ints of src to dst, reversing the bytes of each  */
+static void swapWords (unsigned int *dst, const unsigned int *src, size_t n) {
+  unsigned int value = 0;
+  size_t i = 0;
+
+  for (i = 0; i < n; i++) {
+    value = src[i];
+    dst[i] = (value >> 24) | ((value >> 8) & 0xFF00U) | ((value << 8) & 0xFF0000U) | (value << 24);
+  }
+
+  return;
+}
+
+
+/*  Whether the file in map, of the given kind, is a plain array of
+**  unsigned ints  */
+static bool plainWords (const MAP_STRUCT *map, enum PARTKIND kind) {
+  SYM_SEQ sym;
+  MOD_SEQ mod;
+
+  if (map -> len == 0) {
+    return (false);
+  }
+  if (kind == PART_SYMSEQ) {
+    (void) symSeqInit (&sym, map, 0xFFFFFFFFU);
+    return ((sym.raw != NULL) ? true : false);
+  }
+  if (kind == PART_MODSEQ) {
+    (void) modSeqInit (&mod, map);
+    return ((mod.raw != NULL) ? true : false);
+  }
+
+  return (false);
+}
+
+
+/*  Write len zero bytes to fp  */
+static void writePadding (FILE *fp, size_t len) {
+  static const unsigned char zeros[CONTAINER_ALIGN] = { 0 };
+
+  (void) fwrite (zeros, sizeof (unsigned char), len, fp);
+
+  return;
+}
+
+
+/*
+**  Pack the files named filename, which must have been closed, into
+**  the container filename.ppc and remove them.  The container is
+**  written to a temporary file, which is renamed once it is complete,
+**  so that a decoder never finds half of one.
+*/
+void containerPack (unsigned char *filename) {
+  MAP_STRUCT maps[NUM_PARTS];
+  unsigned int flags[NUM_PARTS];
+  unsigned long long offsets[NUM_PARTS];
+  unsigned char *names[NUM_PARTS];
+  unsigned int parts[NUM_PARTS];
+  unsigned char header[CONTAINER_HEADER_SIZE + CONTAINER_MAXSECTIONS * CONTAINER_ENTRY_SIZE];
+  unsigned char *entry = NULL;
+  unsigned char *ppc_name = NULL;
+  unsigned char *tmp_name = NULL;
+  unsigned int *buf = NULL;
+  size_t len = ustrlen (filename);
+  size_t header_len = 0;
+  size_t done = 0;
+  size_t n = 0;
+  unsigned long long pos = 0;
+  unsigned int nparts = 0;
+  unsigned int i = 0;
+  unsigned int k = 0;
+  bool swap = bigEndian ();
+  FILE *fp = NULL;
+
+  for (i = 0; i < NUM_PARTS; i++) {
+    names[i] = wmalloc (sizeof (unsigned char) * (len + 2 + strlen (part_exts[i])));
+    (void) snprintf ((char*) names[i], len + 2 + strlen (part_exts[i]), "%s.%s", (char*) filename, part_exts[i]);
+  }
+  for (i = 0; i < NUM_REQUIRED_PARTS; i++) {
+    parts[nparts++] = i;
+  }
+  if (access ((char*) names[PART_CFX], F_OK) == 0) {
+    parts[nparts++] = PART_CFX;
+  }
+  if ((access ((char*) names[PART_SRF], F_OK) == 0) && (access ((char*) names[PART_SS], F_OK) == 0)) {
+    parts[nparts++] = PART_SRF;
+    parts[nparts++] = PART_SS;
+  }
+
+  /*  Lay the sections out after the header and directory  */
+  header_len = CONTAINER_HEADER_SIZE + nparts * CONTAINER_ENTRY_SIZE;
+  memset (header, 0, header_len);
+  memcpy (header, CONTAINER_MAGIC, 3);
+  header[3] = (unsigned char) CONTAINER_VERSION;
+  putLE (header + 8, (unsigned long long) nparts, 4);
+  pos = (unsigned long long) header_len;
+  for (i = 0; i < nparts; i++) {
+    k = parts[i];
+    mapFile (names[k], &maps[i], ACCESS_SEQUENTIAL);
+    flags[i] = (plainWords (&maps[i], part_kinds[k]) == true) ? CONTAINER_WORDS : 0;
+    pos = (pos + CONTAINER_ALIGN - 1) & ~((unsigned long long) CONTAINER_ALIGN - 1);
+    offsets[i] = pos;
+    pos += (unsigned long long) maps[i].len;
+
+    entry = header + CONTAINER_HEADER_SIZE + i * CONTAINER_ENTRY_SIZE;
+    memcpy (entry, part_exts[k], strlen (part_exts[k]));
+    putLE (entry + 8, offsets[i], 8);
+    putLE (entry + 16, (unsigned long long) maps[i].len, 8);
+    putLE (entry + 24, (unsigned long long) flags[i], 4);
+  }
+
+  ppc_name = wmalloc (sizeof (unsigned char) * (len + 5));
+  (void) snprintf ((char*) ppc_name, len + 5, "%s.ppc", (char*) filename);
+  tmp_name = wmalloc (sizeof (unsigned char) * (len + 9));
+  (void) snprintf ((char*) tmp_name, len + 9, "%s.ppc.tmp", (char*) filename);
+  FOPEN (tmp_name, fp, "w");
+
+  (void) fwrite (header, sizeof (unsigned char), header_len, fp);
+  pos = (unsigned long long) header_len;
+  if (swap == true) {
+    buf = wmalloc (sizeof (unsigned int) * OUTBUFMAX);
+  }
+  for (i = 0; i < nparts; i++) {
+    writePadding (fp, (size_t) (offsets[i] - pos));
+    if ((swap == true) && (flags[i] == CONTAINER_WORDS)) {
+      /*  Plain arrays are stored little-endian  */
+      n = maps[i].len / sizeof (unsigned int);
+      for (done = 0; done < n; done += OUTBUFMAX) {
+        swapWords (buf, (const unsigned int*) maps[i].addr + done, (n - done < OUTBUFMAX) ? n - done : OUTBUFMAX);
+        (void) fwrite (buf, sizeof (unsigned int), (n - done < OUTBUFMAX) ? n - done : OUTBUFMAX, fp);
+      }
+    }
+    else if (maps[i].len != 0) {
+      (void) fwrite (maps[i].addr, sizeof (unsigned char), maps[i].len, fp);
+    }
+    pos = offsets[i] + (unsigned long long) maps[i].len;
+    unmapFile (&maps[i]);
+  }
+  if ((ferror (fp) != 0) || (fclose (fp) != 0)) {
+    fprintf (stderr, "Error writing %s (%s, line %u).\n", tmp_name, __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+
+  if (rename ((char*) tmp_name, (char*) ppc_name) != 0) {
+    fprintf (stderr, "Error renaming %s (%s, line %u).\n", tmp_name, __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+  for (i = 0; i < NUM_PARTS; i++) {
+    (void) unlink ((char*) names[i]);
+    wfree (names[i]);
+  }
+
+  if (buf != NULL) {
+    wfree (buf);
+  }
+  wfree (tmp_name);
+  wfree (ppc_name);
+
+  return;
+}
+
+
+/*  Check the header and directory of the container name, held in
+**  container  */
+void containerCheck (const MAP_STRUCT *container, const unsigned char *name) {
+  const unsigned char *p = (const unsigned char*) container -> addr;
+  const unsigned char *entry = NULL;
+  unsigned long long nsections = 0;
+  unsigned long long offset = 0;
+  unsigned long long length = 0;
+  unsigned int i = 0;
+
+  if ((container -> len < CONTAINER_HEADER_SIZE) || (memcmp (p, CONTAINER_MAGIC, 3) != 0)) {
+    fprintf (stderr, "%s is not a container (%s, line %u).\n", name, __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+  if (p[3] != (unsigned char) CONTAINER_VERSION) {
+    fprintf (stderr, "Unsupported container version %u (%s, line %u).\n", (unsigned int) p[3], __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+  nsections = getLE (p + 8, 4);
+  if ((nsections > CONTAINER_MAXSECTIONS) || (container -> len < CONTAINER_HEADER_SIZE + nsections * CONTAINER_ENTRY_SIZE)) {
+    fprintf (stderr, "Corrupt container directory in %s (%s, line %u).\n", name, __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+  for (i = 0; i < (unsigned int) nsections; i++) {
+    entry = p + CONTAINER_HEADER_SIZE + i * CONTAINER_ENTRY_SIZE;
+    offset = getLE (entry + 8, 8);
+    length = getLE (entry + 16, 8);
+    if ((offset % CONTAINER_ALIGN != 0) || (offset > (unsigned long long) container -> len) || (length > (unsigned long long) container -> len - offset)) {
+      fprintf (stderr, "Corrupt container section %u in %s (%s, line %u).\n", i, name, __FILE__, __LINE__);
+      exit (EXIT_FAILURE);
+    }
+  }
+
+  return;
+}
+
+
+/*
+**  Find the section for the extension ext (without the dot) of the
+**  checked container and set section to it.  The section is used
+**  where the container is held, except for a plain array on a
+**  big-endian host, which is copied.  unmapFile may be called on
+**  section either way, but it must not outlive the container.  Returns
+**  false if there is no such section.
+*/
+bool containerSection (const MAP_STRUCT *container, const char *ext, MAP_STRUCT *section) {
+  const unsigned char *p = (const unsigned char*) container -> addr;
+  const unsigned char *entry = NULL;
+  unsigned int nsections = (unsigned int) getLE (p + 8, 4);
+  size_t ext_len = strlen (ext);
+  unsigned int i = 0;
+
+  for (i = 0; i < nsections; i++) {
+    entry = p + CONTAINER_HEADER_SIZE + i * CONTAINER_ENTRY_SIZE;
+    if ((ext_len < CONTAINER_NAME_SIZE) && (memcmp (entry, ext, ext_len) == 0) && (entry[ext_len] == '\0')) {
+      break;
+    }
+  }
+  if (i == nsections) {
+    return (false);
+  }
+
+  section -> len = (size_t) getLE (entry + 16, 8);
+  section -> addr = (void*) (p + getLE (entry + 8, 8));
+  section -> mapped = container -> mapped;
+  section -> section = true;
+  if (section -> len == 0) {
+    section -> addr = NULL;
+  }
+  else if ((((unsigned int) getLE (entry + 24, 4) & CONTAINER_WORDS) != 0) && (bigEndian () == true)) {
+    section -> addr = wmalloc (section -> len);
+    swapWords ((unsigned int*) section -> addr, (const unsigned int*) (p + getLE (entry + 8, 8)), section -> len / sizeof (unsigned int));
+    section -> mapped = false;
+    section -> section = false;
+  }
+
+  return (true);
+}
@@ -0,0 +1,42 @@
+#ifndef CONTAINER_H
+#define CONTAINER_H
+
+/*  With -C, the files of an encoding are packed, after they are
+**  written, into a single container file (".ppc") and removed.  A
+**  decoder which finds the container reads every file from it instead.
+**  The container begins with a header of CONTAINER_HEADER_SIZE bytes:
+**    bytes 0-2:   the magic string CONTAINER_MAGIC
+**    byte 3:      the version of the format (CONTAINER_VERSION)
+**    bytes 4-7:   reserved (0)
+**    bytes 8-11:  the number of sections (little-endian)
+**    bytes 12-15: reserved (0)
+**  It is followed by a directory of CONTAINER_ENTRY_SIZE bytes for
+**  each section:
+**    bytes 0-7:   the extension of the file, without the dot, padded
+**                 with NULs
+**    bytes 8-15:  the offset of the section (little-endian)
+**    bytes 16-23: the length of the section (little-endian)
+**    bytes 24-27: flags (little-endian)
+**    bytes 28-31: reserved (0)
+**  Each section holds the file as it was written and begins on a
+**  multiple of CONTAINER_ALIGN bytes, so that it can be used where the
+**  container is mapped.  All of a container is little-endian:  a
+**  section flagged CONTAINER_WORDS is a plain array of unsigned ints
+**  (.ws, .nws, .cfm, .sm or .ss without a header), which is
+**  byte-swapped when it is packed or read on a big-endian host.  */
+#define CONTAINER_MAGIC "PPC"
+#define CONTAINER_VERSION 1
+#define CONTAINER_HEADER_SIZE 16
+#define CONTAINER_ENTRY_SIZE 32
+#define CONTAINER_NAME_SIZE 8
+#define CONTAINER_ALIGN 4096
+#define CONTAINER_WORDS 0x1
+
+/*  The most sections a container may have  */
+#define CONTAINER_MAXSECTIONS 16
+
+void containerPack (unsigned char *filename);
+void containerCheck (const MAP_STRUCT *container, const unsigned char *name);
+bool containerSection (const MAP_STRUCT *container, const char *ext, MAP_STRUCT *section);
+
+#endif
@@ -10,9 +10,17 @@
 #include "ustring.h"
 #include "prepair-defn.h"
 #include "fcode.h"
+#include "word.h"
+#include "nonword.h"
+#include "prepair.h"
+#include "byteorder.h"
 
 static FCODETREE *splayFcode (FCODETREE *p);
 static void traverseFcodeDict (FCODETREE *t, FCODENODE *fcode_dict, bool printsorted, unsigned int *fcode_map, unsigned int *pos);
+static unsigned int hashFcode (unsigned char *item, unsigned int len);
+static void growFcodeHash (FCODEHASH *fcode_hash);
+static int compareFcodeNode (const void *a, const void *b);
+static void sortFcodeHash (FCODEHASH *fcode_hash, FCODENODE *fcode_dict, bool printsorted, unsigned int *fcode_map, unsigned int nitems);
 
 /* Splay the tree about node p. The new root (i.e. node p) is
 ** returned. The splay operation is described in Sleator and Tarjan,
@@ -80,9 +88,10 @@ static void traverseFcodeDict (FCODETREE *t, FCODENODE *fcode_dict, bool printso
 
 /*
 **  Process the item by inserting it into a splay tree (or updating the
-**  frequency if it already exists).  Return the item's id.
+**  frequency if it already exists).  New nodes and their items are
+**  allocated from arena.  Return the item's id.
 */
-unsigned int fcodeEncode (unsigned char *item, unsigned int len, FCODETREE **fcode_root, unsigned int *itemcount, unsigned int *item_compares, unsigned int *total_itemlen) {
+unsigned int fcodeEncode (unsigned char *item, unsigned int len, FCODETREE **fcode_root, WMARENA *arena, unsigned int *itemcount, unsigned long long *item_compares, unsigned long long *total_itemlen) {
   int cmp = 0;
   FCODETREE *p, *q;
   unsigned int key = 0;
@@ -115,8 +124,8 @@ unsigned int fcodeEncode (unsigned char *item, unsigned int len, FCODETREE **fco
   if (!p) {
     /* the search failed to find the item */
     /* make and fill a new tree node */
-    p = wmalloc (sizeof (FCODETREE) * 1);
-    p -> item = wmalloc (sizeof (unsigned char) * (size_t) len);
+    p = wmArenaAlloc (arena, sizeof (FCODETREE), sizeof (void*));
+    p -> item = wmArenaAlloc (arena, sizeof (unsigned char) * (size_t) len, 1);
     ustrncpy (p -> item, item, len);
     p -> id = *itemcount;
     (*itemcount)++;
@@ -149,13 +158,319 @@ unsigned int fcodeEncode (unsigned char *item, unsigned int len, FCODETREE **fco
 }
 
 
-void fcodeDictEncode (FILE_STRUCT *file_info, FCODETREE *fcode_root, FCODENODE *fcode_dict, unsigned int *fcode_map, bool printsorted, unsigned int nitems, enum WORDTYPE type) {
+/*
+**  FNV-1a hash of an item.
+*/
+static unsigned int hashFcode (unsigned char *item, unsigned int len) {
+  unsigned int h = 2166136261u;
+  unsigned int i = 0;
+
+  for (i = 0; i < len; i++) {
+    h = (h ^ (unsigned int) item[i]) * 16777619u;
+  }
+
+  return (h);
+}
+
+
+/*
+**  Double the number of slots and re-insert every id.  The stored
+**  hash values mean that no item needs to be re-hashed.
+*/
+static void growFcodeHash (FCODEHASH *fcode_hash) {
+  FCODESLOT *old_slots = fcode_hash -> slots;
+  unsigned int old_nslots = fcode_hash -> nslots;
+  unsigned int mask = 0;
+  unsigned int pos = 0;
+  unsigned int i = 0;
+
+  fcode_hash -> nslots = old_nslots << 1;
+  fcode_hash -> slots = wmalloc (sizeof (FCODESLOT) * fcode_hash -> nslots);
+  memset (fcode_hash -> slots, 0, sizeof (FCODESLOT) * fcode_hash -> nslots);
+  mask = fcode_hash -> nslots - 1;
+
+  for (i = 0; i < old_nslots; i++) {
+    if (old_slots[i].id != EMPTY_FCODE) {
+      pos = old_slots[i].hash & mask;
+      while (fcode_hash -> slots[pos].id != EMPTY_FCODE) {
+        pos = (pos + 1) & mask;
+      }
+      fcode_hash -> slots[pos] = old_slots[i];
+    }
+  }
+  wfree (old_slots);
+
+  return;
+}
+
+
+FCODEHASH *fcodeHashInit (void) {
+  FCODEHASH *fcode_hash = wmalloc (sizeof (FCODEHASH));
+
+  fcode_hash -> nslots = INIT_FCODE_HASH_SIZE;
+  fcode_hash -> slots = wmalloc (sizeof (FCODESLOT) * fcode_hash -> nslots);
+  memset (fcode_hash -> slots, 0, sizeof (FCODESLOT) * fcode_hash -> nslots);
+
+  fcode_hash -> nentries = INIT_FCODE_HASH_SIZE >> 1;
+  fcode_hash -> entries = wmalloc (sizeof (FCODEENTRY) * fcode_hash -> nentries);
+
+  fcode_hash -> pool_size = INIT_FCODE_POOL_SIZE;
+  fcode_hash -> pool_used = 0;
+  fcode_hash -> pool = wmalloc (sizeof (unsigned char) * fcode_hash -> pool_size);
+
+  return (fcode_hash);
+}
+
+
+/*
+**  Process the item by inserting it into the hash lexicon (or updating
+**  the frequency if it already exists).  Return the item's id.
+*/
+unsigned int fcodeHashEncode (unsigned char *item, unsigned int len, FCODEHASH *fcode_hash, unsigned int *itemcount, unsigned long long *item_compares, unsigned long long *total_itemlen) {
+  unsigned int h = 0;
+  unsigned int mask = fcode_hash -> nslots - 1;
+  unsigned int pos = 0;
+  unsigned int key = 0;
+  FCODEENTRY *entry = NULL;
+
+  if (len == 0) {
+    return (EMPTY_FCODE);
+  }
+
+  h = hashFcode (item, len);
+  pos = h & mask;
+  while (fcode_hash -> slots[pos].id != EMPTY_FCODE) {
+    (*item_compares)++;
+    if (fcode_hash -> slots[pos].hash == h) {
+      entry = &(fcode_hash -> entries[fcode_hash -> slots[pos].id]);
+      if ((entry -> len == len) && (memcmp (fcode_hash -> pool + entry -> offset, item, (size_t) len) == 0)) {
+        (entry -> freq)++;
+        return (fcode_hash -> slots[pos].id);
+      }
+    }
+    pos = (pos + 1) & mask;
+  }
+
+  /*  The search failed to find the item, so add it to the end of the
+  **  pool and claim the empty slot.  */
+  key = *itemcount;
+  (*itemcount)++;
+  if (key >= fcode_hash -> nentries) {
+    fcode_hash -> nentries = fcode_hash -> nentries << 1;
+    fcode_hash -> entries = wrealloc (fcode_hash -> entries, sizeof (FCODEENTRY) * fcode_hash -> nentries);
+  }
+  while (fcode_hash -> pool_used + len > fcode_hash -> pool_size) {
+    fcode_hash -> pool_size = fcode_hash -> pool_size << 1;
+    fcode_hash -> pool = wrealloc (fcode_hash -> pool, sizeof (unsigned char) * fcode_hash -> pool_size);
+  }
+
+  entry = &(fcode_hash -> entries[key]);
+  entry -> offset = fcode_hash -> pool_used;
+  entry -> len = len;
+  entry -> freq = 1;
+  memcpy (fcode_hash -> pool + fcode_hash -> pool_used, item, (size_t) len);
+  fcode_hash -> pool_used += len;
+  (*total_itemlen) += len;
+
+  fcode_hash -> slots[pos].hash = h;
+  fcode_hash -> slots[pos].id = key;
+
+  /*  Keep the table at most half full  */
+  if (((*itemcount) << 1) > fcode_hash -> nslots) {
+    growFcodeHash (fcode_hash);
+  }
+
+  return (key);
+}
+
+
+void fcodeHashFree (FCODEHASH *fcode_hash) {
+  wfree (fcode_hash -> pool);
+  wfree (fcode_hash -> entries);
+  wfree (fcode_hash -> slots);
+  wfree (fcode_hash);
+
+  return;
+}
+
+
+static int compareFcodeNode (const void *a, const void *b) {
+  const FCODENODE *x = (const FCODENODE *) a;
+  const FCODENODE *y = (const FCODENODE *) b;
+
+  return (ustrncmp (x -> item, x -> len, y -> item, y -> len));
+}
+
+
+/*
+**  Gather the items of the hash lexicon (in order of their ids) and
+**  sort them once.  This produces the same dictionary and map as an
+**  in-order traversal of the equivalent splay tree.
+*/
+static void sortFcodeHash (FCODEHASH *fcode_hash, FCODENODE *fcode_dict, bool printsorted, unsigned int *fcode_map, unsigned int nitems) {
+  unsigned int i = 0;
+
+  /*  Word id #0 not used  */
+  fcode_dict[0].item = NULL;
+  fcode_dict[0].init_id = 0;
+  fcode_dict[0].id = 0;
+
+  for (i = FIRST_FCODE; i < nitems; i++) {
+    fcode_dict[i].item = fcode_hash -> pool + fcode_hash -> entries[i].offset;
+    fcode_dict[i].len = fcode_hash -> entries[i].len;
+    fcode_dict[i].freq = fcode_hash -> entries[i].freq;
+    fcode_dict[i].init_id = i;
+  }
+
+  if (nitems > FIRST_FCODE) {
+    qsort (fcode_dict + FIRST_FCODE, (size_t) (nitems - FIRST_FCODE), sizeof (FCODENODE), compareFcodeNode);
+  }
+
+  for (i = FIRST_FCODE; i < nitems; i++) {
+    fcode_dict[i].id = i;
+    fcode_map[fcode_dict[i].init_id] = i;
+    if (printsorted == true) {
+      printf ("%10u\t", fcode_dict[i].freq);
+      uprintf (stderr, fcode_dict[i].item, fcode_dict[i].len);
+      printf (" (%u)\n", fcode_dict[i].len);
+    }
+  }
+
+  return;
+}
+
+
+/*  Write value to p as a varint, returning the new position  */
+static unsigned char *putVarint (unsigned char *p, unsigned int value) {
+  while (value >= 0x80) {
+    *p = (unsigned char) ((value & 0x7F) | 0x80);
+    p++;
+    value = value >> 7;
+  }
+  *p = (unsigned char) value;
+  p++;
+
+  return (p);
+}
+
+
+/*  Read a varint from p into value, returning the new position, or
+**  NULL if it does not end before end or is too long  */
+static const unsigned char *getVarint (const unsigned char *p, const unsigned char *end, unsigned int *value) {
+  unsigned int shift = 0;
+
+  *value = 0;
+  while ((p < end) && ((*p & 0x80) != 0)) {
+    *value = *value | ((unsigned int) (*p & 0x7F) << shift);
+    shift += 7;
+    p++;
+    if (shift > 28) {
+      return (NULL);
+    }
+  }
+  if (p == end) {
+    return (NULL);
+  }
+  *value = *value | ((unsigned int) *p << shift);
+  p++;
+
+  return (p);
+}
+
+
+/*
+**  Traverse the word tree (or sort the hash lexicon) and save it to
+**  fcode_dict in sorted order.  fcode_map is filled with the sorted
+**  id of each item, indexed by the id it was given when first seen.
+*/
+void fcodeDictSort (FCODETREE *fcode_root, FCODEHASH *fcode_hash, FCODENODE *fcode_dict, unsigned int *fcode_map, bool printsorted, unsigned int nitems) {
+  unsigned int pos = FIRST_FCODE;
+
+  if (fcode_hash != NULL) {
+    sortFcodeHash (fcode_hash, fcode_dict, printsorted, fcode_map, nitems);
+  }
+  else {
+    traverseFcodeDict (fcode_root, fcode_dict, printsorted, fcode_map, &pos);
+  }
+
+  return;
+}
+
+
+/*  Write the header of a dictionary file into buf  */
+static void writeFcodeHeader (unsigned char *buf, unsigned int count, bool flat) {
+  memcpy (buf, FCODE_MAGIC, 3);
+  buf[3] = (unsigned char) ((flat == true) ? FCODE_FLAT_VERSION : FCODE_VERSION);
+  buf[4] = 0;
+  buf[5] = 0;
+  buf[6] = 0;
+  buf[7] = 0;
+  putLE (buf + 8, (unsigned long long) count, 4);
+
+  return;
+}
+
+
+/*
+**  Write the sorted entries of fcode_dict in the flat format, through
+**  buf (p is the current position and end its soft end, as for
+**  front-coding).  Returns the new position in buf.
+*/
+static unsigned char *writeFlatDict (FILE *fp, unsigned char *buf, unsigned char *p, unsigned char *end, FCODENODE *fcode_dict, unsigned int nitems) {
+  unsigned int curr = 0;
+  size_t total = 0;
+
+  for (curr = FIRST_FCODE; curr < nitems; curr++) {
+    total += fcode_dict[curr].len;
+  }
+  if (total > UINT_MAX) {
+    fprintf (stderr, "Dictionary too large for the flat format (%s, line %u).\n", __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+
+  writeFcodeHeader (p, nitems - FIRST_FCODE, true);
+  putLE (p + FCODE_HEADER_SIZE, (unsigned long long) total, 4);
+  p += FCODE_FLAT_HEADER_SIZE;
+
+  /*  The zero-length entry starts and ends at 0  */
+  putLE (p, 0, 4);
+  p += sizeof (unsigned int);
+  total = 0;
+  for (curr = 0; curr < nitems; curr++) {
+    if (curr >= FIRST_FCODE) {
+      total += fcode_dict[curr].len;
+    }
+    putLE (p, (unsigned long long) total, 4);
+    p += sizeof (unsigned int);
+    if (p > end) {
+      (void) fwrite (buf, sizeof (unsigned char), (size_t) (p - buf), fp);
+      p = buf;
+    }
+  }
+
+  for (curr = FIRST_FCODE; curr < nitems; curr++) {
+    memcpy (p, fcode_dict[curr].item, (size_t) fcode_dict[curr].len);
+    p += fcode_dict[curr].len;
+    if (p > end) {
+      (void) fwrite (buf, sizeof (unsigned char), (size_t) (p - buf), fp);
+      p = buf;
+    }
+  }
+
+  return (p);
+}
+
+
+void fcodeDictEncode (FILE_STRUCT *file_info, FCODETREE *fcode_root, FCODEHASH *fcode_hash, FCODENODE *fcode_dict, unsigned int *fcode_map, bool printsorted, unsigned int nitems, enum WORDTYPE type) {
   unsigned int curr = FIRST_FCODE;
   FILE *fp = NULL;
   unsigned char *buf = NULL;
   unsigned char *p = NULL;
   unsigned char *end = NULL;
-  unsigned int pos = FIRST_FCODE;
+  unsigned int prefix = 0;
+  unsigned int suffix = 0;
+  unsigned char *prev = NULL;
+  unsigned int prev_len = 0;
 
   if (type == ISWORD) {
     fp = file_info -> wd_fp;
@@ -170,15 +485,49 @@ void fcodeDictEncode (FILE_STRUCT *file_info, FCODETREE *fcode_root, FCODENODE *
     end = file_info -> nwd_end;
   }
 
-  /*  Traverse the wordtree and save it to an array  */
-  traverseFcodeDict (fcode_root, fcode_dict, printsorted, fcode_map, &pos);
+  fcodeDictSort (fcode_root, fcode_hash, fcode_dict, fcode_map, printsorted, nitems);
+
+  if (file_info -> flat_dicts == true) {
+    p = writeFlatDict (fp, buf, p, end, fcode_dict, nitems);
+    nitems = FIRST_FCODE;
+  }
+  else {
+    writeFcodeHeader (p, nitems - FIRST_FCODE, false);
+    p += FCODE_HEADER_SIZE;
+  }
 
   /*  Do not encode word in position 0, the zero-length word  */
   while (curr < nitems) {
-    *p = (unsigned char) fcode_dict[curr].len;
+    prefix = 0;
+    while ((prefix < prev_len) && (prefix < fcode_dict[curr].len) && (prev[prefix] == fcode_dict[curr].item[prefix])) {
+      prefix++;
+    }
+    suffix = fcode_dict[curr].len - prefix;
+
+    if (prefix < FCODE_NIBBLE_ESC) {
+      *p = (unsigned char) (prefix << 4);
+    }
+    else {
+      *p = (unsigned char) (FCODE_NIBBLE_ESC << 4);
+    }
+    if (suffix - 1 < FCODE_NIBBLE_ESC) {
+      *p = *p | (unsigned char) (suffix - 1);
+    }
+    else {
+      *p = *p | (unsigned char) FCODE_NIBBLE_ESC;
+    }
     (p)++;
-    memcpy (p, fcode_dict[curr].item, (size_t) fcode_dict[curr].len);
-    (p) += fcode_dict[curr].len;
+    if (prefix >= FCODE_NIBBLE_ESC) {
+      p = putVarint (p, prefix - FCODE_NIBBLE_ESC);
+    }
+    if (suffix - 1 >= FCODE_NIBBLE_ESC) {
+      p = putVarint (p, suffix - 1 - FCODE_NIBBLE_ESC);
+    }
+    memcpy (p, fcode_dict[curr].item + prefix, (size_t) suffix);
+    (p) += suffix;
+
+    prev = fcode_dict[curr].item;
+    prev_len = fcode_dict[curr].len;
     curr++;
 
     if (p > end) {
@@ -198,68 +547,230 @@ void fcodeDictEncode (FILE_STRUCT *file_info, FCODETREE *fcode_root, FCODENODE *
 }
 
 
-unsigned int fcodeDictDecode (FILE_STRUCT *file_info, FCODENODE **fcode_dict, unsigned int nitems, enum WORDTYPE type) {
-  unsigned int i = 0;
-  unsigned int buffsize = 0;
-  unsigned int diff;
-
+/*
+**  Write entries 1 to nitems - 1 of fcode_dict, in the order given,
+**  to the file name in the flat format.  Unlike the dictionaries, the
+**  entries need not be sorted.
+*/
+void fcodeFlatDictWrite (unsigned char *name, FCODENODE *fcode_dict, unsigned int nitems) {
   FILE *fp = NULL;
-  unsigned char *buf = NULL;
+  unsigned char *buf = wmalloc (sizeof (unsigned char) * OUTBUFMAX);
   unsigned char *p = NULL;
-  unsigned char *end = NULL;
 
-  unsigned int init_nitems = nitems;
+  FOPEN (name, fp, "w");
+  p = writeFlatDict (fp, buf, buf, buf + OUTBUFMAX - (MAXWORDLEN + FCODE_FLAT_HEADER_SIZE + 1), fcode_dict, nitems);
+  if (p != buf) {
+    (void) fwrite (buf, sizeof (unsigned char), (size_t) (p - buf), fp);
+  }
+  if (fclose (fp) != 0) {
+    fprintf (stderr, "Error writing %s (%s, line %u).\n", name, __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+  wfree (buf);
 
-  if (type == ISWORD) {
-    fp = file_info -> wd_fp;
-    buf = file_info -> wd_buf;
-    p = file_info -> wd_p;
-    end = file_info -> wd_end;
+  return;
+}
+
+
+/*
+**  Set up dict from a flat dictionary in map, of count entries (plus
+**  the zero-length entry).  Only the sizes are checked, so this takes
+**  the same time whatever the size of the dictionary; the offsets
+**  are checked by LOOKUPFCODE.  On a big-endian host, the offsets
+**  (and the strings, so that the file can be released) are copied.
+*/
+static void flatDictLoad (FCODEDICT *dict, MAP_STRUCT *map, unsigned int count) {
+  const unsigned char *base = (const unsigned char*) map -> addr;
+  size_t noffsets = (size_t) count + 2;
+  size_t table_end = 0;
+  size_t i = 0;
+
+  if (map -> len < FCODE_FLAT_HEADER_SIZE) {
+    fprintf (stderr, "Flat dictionary of the wrong size (%s, line %u).\n", __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+  dict -> pool_len = (size_t) getLE (base + FCODE_HEADER_SIZE, 4);
+  table_end = FCODE_FLAT_HEADER_SIZE + noffsets * sizeof (unsigned int);
+  if ((map -> len < table_end) || (map -> len - table_end != dict -> pool_len)) {
+    fprintf (stderr, "Flat dictionary of the wrong size (%s, line %u).\n", __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+  dict -> nitems = count + FIRST_FCODE;
+
+  if (bigEndian () == false) {
+    /*  Entries are looked up in any order  */
+    dict -> in_place = true;
+    adviseMap (map, ACCESS_RANDOM);
+    dict -> map = *map;
+    dict -> offset = (unsigned int*) (base + FCODE_FLAT_HEADER_SIZE);
+    dict -> pool = (unsigned char*) (base + table_end);
   }
   else {
-    fp = file_info -> nwd_fp;
-    buf = file_info -> nwd_buf;
-    p = file_info -> nwd_p;
-    end = file_info -> nwd_end;
+    dict -> in_place = false;
+    dict -> offset = wmalloc (sizeof (unsigned int) * noffsets);
+    for (i = 0; i < noffsets; i++) {
+      dict -> offset[i] = (unsigned int) getLE (base + FCODE_FLAT_HEADER_SIZE + i * sizeof (unsigned int), 4);
+    }
+    dict -> pool = wmalloc (sizeof (unsigned char) * (dict -> pool_len + 1));
+    memcpy (dict -> pool, base + table_end, dict -> pool_len);
+    unmapFile (map);
+  }
+
+  return;
+}
+
+
+/*
+**  Read the dictionary of the given type into dict.  Returns the
+**  number of entries, including the zero-length entry.
+*/
+unsigned int fcodeDictDecode (FILE_STRUCT *file_info, FCODEDICT *dict, enum WORDTYPE type) {
+  return (fcodeDictDecodePart (file_info, (type == ISWORD) ? file_info -> wd_name : file_info -> nwd_name, dict));
+}
+
+
+/*
+**  Read the dictionary in the file name (or in its section of the
+**  container) into dict.  The file is mapped (or read) in one go.  A
+**  flat dictionary is used as it is; otherwise, the entries are
+**  decoded into a single pool, with the offset of each.  Returns the
+**  number of entries, including the zero-length entry.
+*/
+unsigned int fcodeDictDecodePart (FILE_STRUCT *file_info, unsigned char *name, FCODEDICT *dict) {
+  MAP_STRUCT map;
+  unsigned int i = 0;
+  unsigned int diff = 0;
+  unsigned int prefix = 0;
+  unsigned int suffix = 0;
+  unsigned int count = 0;
+  unsigned int size = INIT_FCODE_SIZE;
+  size_t pool_size = 0;
+  bool front_coded = false;
+  bool escaped = false;
+
+  const unsigned char *p = NULL;
+  const unsigned char *end = NULL;
+
+  mapPart (file_info, name, &map, ACCESS_NORMAL);
+  p = (const unsigned char*) map.addr;
+  end = p + map.len;
+
+  /*  Check for a header; without one, the file is from an earlier
+  **  version and holds the entries uncoded.  */
+  if ((map.len >= FCODE_HEADER_SIZE) && (memcmp (p, FCODE_MAGIC, 3) == 0)) {
+    if ((p[3] == 0) || (p[3] > (unsigned char) FCODE_FLAT_VERSION)) {
+      fprintf (stderr, "Unsupported dictionary version %u (%s, line %u).\n", (unsigned int) p[3], __FILE__, __LINE__);
+      exit (EXIT_FAILURE);
+    }
+    count = (unsigned int) getLE (p + 8, 4);
+    if (p[3] == (unsigned char) FCODE_FLAT_VERSION) {
+      flatDictLoad (dict, &map, count);
+      return (dict -> nitems);
+    }
+    front_coded = true;
+    escaped = (p[3] >= 2);
+    p += FCODE_HEADER_SIZE;
+
+    /*  The size of the dictionary is known, so allocate it once  */
+    size = count + FIRST_FCODE;
+  }
+
+  /*  Front-coding rarely saves more than half of the bytes; the pool
+  **  is enlarged if it does  */
+  pool_size = (front_coded == true) ? 2 * map.len : map.len;
+  if (pool_size < INIT_FCODE_SIZE) {
+    pool_size = INIT_FCODE_SIZE;
   }
+  dict -> in_place = false;
+  dict -> pool = wmalloc (sizeof (unsigned char) * pool_size);
+  dict -> pool_len = 0;
+  dict -> offset = wmalloc (sizeof (unsigned int) * (size + 1));
 
   /*  The 0th word is the zero-length word  */
-  (*fcode_dict)[0].item = NULL;
-  (*fcode_dict)[0].len = 0;
+  dict -> offset[0] = 0;
+  dict -> offset[1] = 0;
 
-  p = end;
   i = FIRST_FCODE;
-  while (true) {
-    if (end - p < (MAXWORDLEN + MAXWORDLEN_HEADER)) {
-      diff = (unsigned int) (end - p);
-      memcpy (buf, p, (size_t) diff);
-      buffsize = (unsigned int) fread (buf + diff, sizeof (unsigned char), (size_t) (OUTBUFMAX - diff), fp);
-      buffsize += diff;
-      end = buf + buffsize;
-      p = buf;
+  while (p < end) {
+    if (i == size) {
+      size = size << 1;
+      dict -> offset = wrealloc (dict -> offset, sizeof (unsigned int) * (size + 1));
     }
-    if ((p == end) && (feof (fp) == true)) {
-      break;
+
+    if (front_coded == true) {
+      prefix = (unsigned int) (*p >> 4);
+      suffix = (unsigned int) (*p & 0xF) + 1;
+      p++;
+      if ((escaped == true) && (prefix == FCODE_NIBBLE_ESC)) {
+        p = getVarint (p, end, &diff);
+        prefix += diff;
+      }
+      if ((p != NULL) && (escaped == true) && (suffix - 1 == FCODE_NIBBLE_ESC)) {
+        p = getVarint (p, end, &diff);
+        suffix += diff;
+      }
+      if ((p == NULL) || (suffix > (unsigned int) (end - p)) || (prefix + suffix > MAXWORDLEN) || ((prefix > 0) && ((i == FIRST_FCODE) || (prefix > dict -> offset[i] - dict -> offset[i - 1])))) {
+        fprintf (stderr, "Corrupt dictionary entry %u (%s, line %u).\n", i, __FILE__, __LINE__);
+        exit (EXIT_FAILURE);
+      }
+    }
+    else {
+      prefix = 0;
+      suffix = (unsigned int) (*p);
+      p++;
+      if (suffix > (unsigned int) (end - p)) {
+        fprintf (stderr, "Corrupt dictionary entry %u (%s, line %u).\n", i, __FILE__, __LINE__);
+        exit (EXIT_FAILURE);
+      }
     }
 
-    (*fcode_dict)[i].len = (unsigned int) (*p);
-    (p)++;
-    (*fcode_dict)[i].item = wmalloc (sizeof (unsigned char) * ((*fcode_dict)[i].len));
-    memcpy ((*fcode_dict)[i].item, p, (size_t) ((*fcode_dict)[i].len));
-    (p) += (*fcode_dict)[i].len;
-    i++;
-    if (i == init_nitems) {
-      init_nitems = init_nitems << 1;
-      (*fcode_dict) = wrealloc ((*fcode_dict), init_nitems * sizeof (FCODENODE));
+    if (dict -> pool_len + prefix + suffix > pool_size) {
+      pool_size = pool_size << 1;
+      dict -> pool = wrealloc (dict -> pool, sizeof (unsigned char) * pool_size);
+    }
+    if (dict -> pool_len + prefix + suffix > UINT_MAX) {
+      fprintf (stderr, "Dictionary too large to decode (%s, line %u).\n", __FILE__, __LINE__);
+      exit (EXIT_FAILURE);
     }
+    memcpy (dict -> pool + dict -> pool_len, dict -> pool + dict -> offset[i - 1], (size_t) prefix);
+    memcpy (dict -> pool + dict -> pool_len + prefix, p, (size_t) suffix);
+    dict -> pool_len += prefix + suffix;
+    dict -> offset[i + 1] = (unsigned int) dict -> pool_len;
+    p += suffix;
+    i++;
   }
 
-  if (type == ISWORD) {
-    file_info -> wd_p = p;
+  if ((front_coded == true) && (i != count + FIRST_FCODE)) {
+    fprintf (stderr, "Dictionary has %u entries instead of %u (%s, line %u).\n", i - FIRST_FCODE, count, __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
   }
-  else {
-    file_info -> nwd_p = p;
+
+  unmapFile (&map);
+  if (dict -> pool_len != 0) {
+    dict -> pool = wrealloc (dict -> pool, sizeof (unsigned char) * dict -> pool_len);
   }
+  dict -> nitems = i;
 
   return (i);
 }
+
+
+void fcodeDictFree (FCODEDICT *dict) {
+  if (dict -> in_place == true) {
+    unmapFile (&dict -> map);
+  }
+  else {
+    wfree (dict -> offset);
+    wfree (dict -> pool);
+  }
+  wfree (dict);
+
+  return;
+}
+
+
+/*  Report a dictionary entry which is out of range  */
+void fcodeDictCorrupt (unsigned int key) {
+  fprintf (stderr, "Corrupt or missing dictionary entry %u (%s, line %u).\n", key, __FILE__, __LINE__);
+  exit (EXIT_FAILURE);
+}
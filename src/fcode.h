@@ -13,6 +13,53 @@
 **  necessary.  */
 #define INIT_FCODE_SIZE 1024
 
+/*  Initial number of slots in a hash lexicon; must be a power of 2.
+**  The table is doubled whenever it becomes half full.  */
+#define INIT_FCODE_HASH_SIZE 65536
+
+/*  Initial size (in bytes) of the string pool of a hash lexicon  */
+#define INIT_FCODE_POOL_SIZE 1048576
+
+/*  Dictionary files (.wd and .nwd) start with a header of
+**  FCODE_HEADER_SIZE bytes:
+**    bytes 0-2:  the magic string FCODE_MAGIC
+**    byte 3:     the version of the format (FCODE_VERSION)
+**    byte 4:     flags (currently 0)
+**    bytes 5-7:  reserved (0)
+**    bytes 8-11: the number of entries, excluding the zero-length
+**                entry (little-endian)
+**  The sorted entries follow, each as a header byte holding the length
+**  of the prefix shared with the previous entry (high 4 bits) and the
+**  length of the remaining suffix, less one (low 4 bits), followed by
+**  the suffix itself.  A field of FCODE_NIBBLE_ESC means that the
+**  length is at least FCODE_NIBBLE_ESC; the rest of it follows the
+**  header byte as a varint (7 bits per byte, low bits first, the top
+**  bit set on all but the last byte), the prefix before the suffix.
+**  The dictionary is always decoded as a whole, so every entry but the
+**  first shares what it can with the previous one; the flat format
+**  below is the one for random access.
+**
+**  In version 1 files, the two fields are never escaped, so prefixes
+**  are at most 15 and entries at most 16 bytes long.  Files without
+**  the magic string are from earlier versions, in which each entry
+**  was a length byte followed by the whole entry.  */
+#define FCODE_MAGIC "PPD"
+#define FCODE_VERSION 2
+#define FCODE_HEADER_SIZE 12
+
+/*  With -M, dictionaries are written in a flat format instead, which
+**  is used directly from a mapping of the file.  Bytes 0-11 of its
+**  header are as above, with a version of FCODE_FLAT_VERSION, and
+**  bytes 12-15 hold the size of the string area (little-endian).  The
+**  header is followed by count + 2 offsets into the string area (4
+**  bytes each, little-endian), and then by the string area itself.
+**  Counting the zero-length entry as entry 0, entry i is made of the
+**  bytes from offset i up to offset i + 1.  */
+#define FCODE_FLAT_VERSION 3
+#define FCODE_FLAT_HEADER_SIZE 16
+
+#define FCODE_NIBBLE_ESC 15
+
 #define FCODETREENULL  ((struct fcodetree *) NULL)
 #define FILENULL  ((FILE *) NULL)
 #define CHARNULL  ((char *) NULL)
@@ -26,6 +73,38 @@ typedef struct fcodetree {
 } FCODETREE;
 
 
+/*  An item in a hash lexicon.  The bytes of the item are kept in
+**  the lexicon's string pool, starting at offset.  */
+typedef struct fcodeentry {
+  unsigned int offset;
+  unsigned int len;
+  unsigned int freq;
+} FCODEENTRY;
+
+
+/*  A slot of a hash lexicon; the hash value is kept with the id so
+**  that most probes never have to visit the string pool.  An id of
+**  EMPTY_FCODE marks an unused slot.  */
+typedef struct fcodeslot {
+  unsigned int hash;
+  unsigned int id;
+} FCODESLOT;
+
+
+/*  Open-addressing (linear probing) hash lexicon.  Ids are assigned
+**  in the order in which items are first seen, exactly as with the
+**  splay tree, and index the entries array directly.  */
+typedef struct fcodehash {
+  FCODESLOT *slots;
+  unsigned int nslots;              /*  Number of slots (a power of 2)  */
+  FCODEENTRY *entries;
+  unsigned int nentries;        /*  Number of entries allocated  */
+  unsigned char *pool;
+  unsigned int pool_used;
+  unsigned int pool_size;
+} FCODEHASH;
+
+
 typedef struct fcodenode {
   unsigned char *item;
   unsigned int len;
@@ -35,9 +114,31 @@ typedef struct fcodenode {
 } FCODENODE;
 
 
+/*  A dictionary loaded for decoding.  Entry i is the bytes from
+**  pool + offset[i] up to pool + offset[i + 1]; entry 0 is the
+**  zero-length entry.  A flat dictionary is used in place, with pool
+**  and offset pointing into the mapped file.  */
+typedef struct fcodedict {
+  unsigned char *pool;
+  size_t pool_len;
+  unsigned int *offset;                  /*  nitems + 1 offsets  */
+  unsigned int nitems;
+  bool in_place;                  /*  pool and offset are in map  */
+  MAP_STRUCT map;
+} FCODEDICT;
+
+
+/*  Point ITEM at entry KEY of the FCODEDICT DICT, of length LEN.  The
+**  offsets of a flat dictionary are not checked when it is loaded, so
+**  each entry is checked as it is used.  */
 #define LOOKUPFCODE(DICT,KEY,ITEM,LEN) \
-  LEN = DICT[KEY].len; \
-  ustrncpy (ITEM, DICT[KEY].item, LEN);
+  do { \
+    if (((KEY) >= (DICT) -> nitems) || ((DICT) -> offset[(KEY) + 1] > (DICT) -> pool_len) || ((DICT) -> offset[(KEY) + 1] - (DICT) -> offset[KEY] > MAXWORDLEN)) { \
+      fcodeDictCorrupt (KEY); \
+    } \
+    LEN = (DICT) -> offset[(KEY) + 1] - (DICT) -> offset[KEY]; \
+    ITEM = (DICT) -> pool + (DICT) -> offset[KEY]; \
+  } while (0)
   
 /* 
 **  Rotations used in the splaying operations
@@ -74,10 +175,19 @@ typedef struct fcodenode {
     } \
   } while (0)
 
-unsigned int fcodeEncode (unsigned char *item, unsigned int len, FCODETREE **fcode_root, unsigned int *itemcount, unsigned int *item_compares, unsigned int *total_itemlen);
+unsigned int fcodeEncode (unsigned char *item, unsigned int len, FCODETREE **fcode_root, WMARENA *arena, unsigned int *itemcount, unsigned long long *item_compares, unsigned long long *total_itemlen);
+
+FCODEHASH *fcodeHashInit (void);
+unsigned int fcodeHashEncode (unsigned char *item, unsigned int len, FCODEHASH *fcode_hash, unsigned int *itemcount, unsigned long long *item_compares, unsigned long long *total_itemlen);
+void fcodeHashFree (FCODEHASH *fcode_hash);
 
-void fcodeDictEncode (FILE_STRUCT *file_info, FCODETREE *fcode_root, FCODENODE *fcode_dict, unsigned int *fcode_map, bool printsorted, unsigned int nitems, enum WORDTYPE type);
+void fcodeDictSort (FCODETREE *fcode_root, FCODEHASH *fcode_hash, FCODENODE *fcode_dict, unsigned int *fcode_map, bool printsorted, unsigned int nitems);
+void fcodeDictEncode (FILE_STRUCT *file_info, FCODETREE *fcode_root, FCODEHASH *fcode_hash, FCODENODE *fcode_dict, unsigned int *fcode_map, bool printsorted, unsigned int nitems, enum WORDTYPE type);
+void fcodeFlatDictWrite (unsigned char *name, FCODENODE *fcode_dict, unsigned int nitems);
 
-unsigned int fcodeDictDecode (FILE_STRUCT *file_info, FCODENODE **fcode_dict, unsigned int nitems, enum WORDTYPE type);
+unsigned int fcodeDictDecode (FILE_STRUCT *file_info, FCODEDICT *dict, enum WORDTYPE type);
+unsigned int fcodeDictDecodePart (FILE_STRUCT *file_info, unsigned char *name, FCODEDICT *dict);
+void fcodeDictFree (FCODEDICT *dict);
+void fcodeDictCorrupt (unsigned int key);
 
 #endif
@@ -0,0 +1,132 @@
+/*
+**  Compile the suffix rules of stemrules.h into the tables used by
+**  stem.c.  Run at build time as:  gen-stemtables <output file>
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "stem.h"
+#include "stemrules.h"
+
+/*  More nodes than any step needs  */
+#define MAX_NODES 256
+
+typedef struct genrule {
+  const char *suf;
+  unsigned int cutlen;
+  const char *newsuf;
+  const char *flag;
+  unsigned int mval;
+  bool st;
+} GENRULE;
+
+#define STEMRULE(SUF,CUTLEN,NEWSUF,FLAG,MVAL,ST) { SUF, CUTLEN, NEWSUF, #FLAG, MVAL, ST },
+static const GENRULE step2[] = { STEP2_RULES };
+static const GENRULE step3[] = { STEP3_RULES };
+static const GENRULE step4[] = { STEP4_RULES };
+#undef STEMRULE
+
+static int child[MAX_NODES][256];
+static unsigned int rule[MAX_NODES];
+
+
+static void genStep (FILE *fp, const char *name, const GENRULE *rules, unsigned int nrules) {
+  unsigned int nnodes = 1;
+  unsigned int node = 0;
+  unsigned int nedges = 0;
+  unsigned int i = 0;
+  unsigned int j = 0;
+  unsigned int c = 0;
+  unsigned int n = 0;
+
+  memset (child, 0, sizeof (child));
+  for (i = 0; i < MAX_NODES; i++) {
+    rule[i] = STEM_NORULE;
+  }
+
+  /*  Insert each suffix backwards; node 0 is the root  */
+  for (i = 0; i < nrules; i++) {
+    node = 0;
+    for (j = (unsigned int) strlen (rules[i].suf); j != 0; j--) {
+      c = (unsigned char) rules[i].suf[j - 1];
+      if (child[node][c] == 0) {
+        if (nnodes == MAX_NODES) {
+          fprintf (stderr, "Too many trie nodes in %s (%s, line %u).\n", name, __FILE__, __LINE__);
+          exit (EXIT_FAILURE);
+        }
+        child[node][c] = (int) nnodes;
+        nnodes++;
+      }
+      node = (unsigned int) child[node][c];
+    }
+    if (rule[node] == STEM_NORULE) {
+      rule[node] = i;
+    }
+  }
+
+  fprintf (fp, "static const STEMRULE %s_rules[] = {\n", name);
+  for (i = 0; i < nrules; i++) {
+    fprintf (fp, "  { %u, %u, \"%s\", %u, %s, %u, %u },\n", (unsigned int) strlen (rules[i].suf), rules[i].cutlen, rules[i].newsuf, (unsigned int) strlen (rules[i].newsuf), rules[i].flag, rules[i].mval, (rules[i].st == true) ? 1U : 0U);
+  }
+  fprintf (fp, "};\n\n");
+
+  fprintf (fp, "static const STEMTRIENODE %s_nodes[] = {\n", name);
+  for (i = 0; i < nnodes; i++) {
+    n = 0;
+    for (c = 0; c < 256; c++) {
+      if (child[i][c] != 0) {
+        n++;
+      }
+    }
+    if (rule[i] == STEM_NORULE) {
+      fprintf (fp, "  { %u, %u, STEM_NORULE },\n", nedges, n);
+    }
+    else {
+      fprintf (fp, "  { %u, %u, %u },\n", nedges, n, rule[i]);
+    }
+    nedges += n;
+  }
+  fprintf (fp, "};\n\n");
+
+  fprintf (fp, "static const STEMTRIEEDGE %s_edges[] = {\n", name);
+  for (i = 0; i < nnodes; i++) {
+    for (c = 0; c < 256; c++) {
+      if (child[i][c] != 0) {
+        fprintf (fp, "  { '%c', %d },\n", (char) c, child[i][c]);
+      }
+    }
+  }
+  fprintf (fp, "};\n\n");
+
+  return;
+}
+
+
+int main (int argc, char *argv[]) {
+  FILE *fp = NULL;
+
+  if (argc != 2) {
+    fprintf (stderr, "Usage:  %s <output file>\n", argv[0]);
+    exit (EXIT_FAILURE);
+  }
+
+  fp = fopen (argv[1], "w");
+  if (fp == NULL) {
+    fprintf (stderr, "Error creating %s.\n", argv[1]);
+    exit (EXIT_FAILURE);
+  }
+
+  fprintf (fp, "/*  Generated by gen-stemtables from stemrules.h; do not edit.  */\n\n");
+  fprintf (fp, "#ifndef STEMTABLES_H\n#define STEMTABLES_H\n\n");
+  genStep (fp, "step2", step2, (unsigned int) (sizeof (step2) / sizeof (GENRULE)));
+  genStep (fp, "step3", step3, (unsigned int) (sizeof (step3) / sizeof (GENRULE)));
+  genStep (fp, "step4", step4, (unsigned int) (sizeof (step4) / sizeof (GENRULE)));
+  fprintf (fp, "#endif\n");
+
+  fclose (fp);
+
+  return (EXIT_SUCCESS);
+}
@@ -0,0 +1,709 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "common-def.h"
+#include "wmalloc.h"
+#include "ustring.h"
+#include "casefold.h"
+#include "stem.h"
+#include "prepair-defn.h"
+#include "fcode.h"
+#include "word.h"
+#include "nonword.h"
+#include "prepair.h"
+#include "surface.h"
+#include "container.h"
+
+/*  Pull the configuration file in  */
+#include "PrePairConfig.h"
+
+/*  Input sizes (in MB) used when none are given  */
+#define BENCH_DEFAULT_SIZES "1,4,16"
+#define BENCH_MAX_SIZES 16
+
+/*  Length of the tokens made longer than MAXWORDLEN by the generator  */
+#define GEN_LONG_LEN 300
+
+/*  Settings of the synthetic corpus.  The rates are fractions of the
+**  tokens (tags and long tokens) or of the words drawn from the
+**  vocabulary (casing).  */
+typedef struct genparams {
+  unsigned long long seed;
+  unsigned int vocab;                  /*  Number of distinct words  */
+  double zipf;              /*  Exponent of the Zipfian distribution  */
+  double capitalized;                  /*  Initial capital letter  */
+  double all_caps;                           /*  Entirely uppercase  */
+  double tags;                         /*  Tags instead of words  */
+  double long_tokens;          /*  Longer than MAXWORDLEN characters  */
+} GEN_PARAMS;
+
+/*  The words of a corpus, as found by getWord, and what case-folding
+**  and stemming made of them  */
+typedef struct benchwords {
+  unsigned char *pool;
+  size_t *offset;
+  unsigned int *len;
+  unsigned int *casefold;
+  unsigned int *stem;
+  size_t nwords;
+} BENCH_WORDS;
+
+static const char *gen_suffixes[] = { "s", "ed", "ing", "ly", "ness", "ation", "ment", "ful", "ize", "er", "ies", "able" };
+static const char *gen_tags[] = { "<p>", "</p>", "<doc>", "</doc>", "<title>", "</title>" };
+
+static void usage (char *progname);
+static unsigned long long nextRandom (unsigned long long *state);
+static double nextUniform (unsigned long long *state);
+static unsigned char *generateCorpus (const GEN_PARAMS *params, size_t len);
+static double elapsedNs (const struct timespec *start, const struct timespec *end);
+static void report (const char *stage, size_t bytes, size_t ntokens, double ns);
+static void collectWords (unsigned char *text, size_t len, BENCH_WORDS *words);
+static void benchSize (const GEN_PARAMS *params, size_t len, unsigned char *base);
+static void removeFiles (unsigned char *base);
+
+
+static void usage (char *progname) {
+  fprintf (stderr, "Pre-Pair benchmark\n");
+  fprintf (stderr, "==================\n\n");
+  fprintf (stderr, "Usage:  %s [options]\n", progname);
+  fprintf (stderr, "  or\n");
+  fprintf (stderr, "        %s -g <bytes> [options] >corpus\n\n", progname);
+  fprintf (stderr, "Generate synthetic corpora with a Zipfian vocabulary and report\n");
+  fprintf (stderr, "the throughput (MB of text per second) and time per record of\n");
+  fprintf (stderr, "each stage of encoding and decoding, for each input size.  With\n");
+  fprintf (stderr, "-g, only write a corpus of the given size to stdout.  The same\n");
+  fprintf (stderr, "options always give the same corpus.\n\n");
+  fprintf (stderr, "Options:\n");
+  fprintf (stderr, "-a\t: Percentage of words in uppercase (default: 1).\n");
+  fprintf (stderr, "-c\t: Percentage of words with an initial capital (default: 10).\n");
+  fprintf (stderr, "-g\t: Write a corpus of this many bytes to stdout and exit.\n");
+  fprintf (stderr, "-h/-?\t: Display this message.\n");
+  fprintf (stderr, "-i\t: Base filename of the files encoded and decoded\n\t  (default: prepair-bench); they are removed afterwards.\n");
+  fprintf (stderr, "-l\t: Percentage of tokens longer than %u characters (default: 0.1).\n", MAXWORDLEN);
+  fprintf (stderr, "-n\t: Input sizes in MB, separated by commas (default: %s).\n", BENCH_DEFAULT_SIZES);
+  fprintf (stderr, "-r\t: Seed of the generator (default: 1).\n");
+  fprintf (stderr, "-t\t: Percentage of tokens which are tags (default: 2).\n");
+  fprintf (stderr, "-V\t: Number of distinct words (default: 50000).\n");
+  fprintf (stderr, "-z\t: Exponent of the Zipfian distribution (default: 1.0).\n\n");
+
+  fprintf (stderr, "Pre-Pair version %u.%u\n", PrePair_VERSION_MAJOR, PrePair_VERSION_MINOR);
+  fprintf (stderr, "Compiled on:  %s (%s)\n\n", __DATE__, __TIME__);
+  exit (EXIT_SUCCESS);
+}
+
+
+/*  splitmix64  */
+static unsigned long long nextRandom (unsigned long long *state) {
+  unsigned long long z = (*state += 0x9E3779B97F4A7C15ULL);
+
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return (z ^ (z >> 31));
+}
+
+
+/*  A uniform value in [0, 1)  */
+static double nextUniform (unsigned long long *state) {
+  return ((double) (nextRandom (state) >> 11) * (1.0 / 9007199254740992.0));
+}
+
+
+/*
+**  Generate len bytes of text.  The vocabulary alternates consonants
+**  and vowels, so that the stemmer has measures to compute, and a
+**  third of the words end with a common suffix.  Word i of the
+**  vocabulary is drawn with a probability proportional to
+**  1 / (i + 1)^zipf.  Words are separated mostly by spaces, with
+**  some punctuation and newlines.  Half of the tags are followed
+**  directly by the next token.
+*/
+static unsigned char *generateCorpus (const GEN_PARAMS *params, size_t len) {
+  static const char consonants[] = "bcdfghjklmnprstvwz";
+  static const char vowels[] = "aeiou";
+  unsigned long long state = params -> seed;
+  unsigned char *text = NULL;
+  unsigned char *vocab = NULL;
+  size_t *vocab_offset = NULL;
+  double *cdf = NULL;
+  double total = 0.0;
+  double u = 0.0;
+  unsigned char token[GEN_LONG_LEN];
+  unsigned int token_len = 0;
+  const char *suffix = NULL;
+  const char *nonword = NULL;
+  size_t pos = 0;
+  size_t lo = 0;
+  size_t hi = 0;
+  size_t mid = 0;
+  unsigned int i = 0;
+  unsigned int j = 0;
+  unsigned int wlen = 0;
+  bool tag = false;
+
+  /*  The vocabulary, at most 8 letters and a suffix of at most 5
+  **  letters per word  */
+  vocab = wmalloc (sizeof (unsigned char) * params -> vocab * 13);
+  vocab_offset = wmalloc (sizeof (size_t) * (params -> vocab + 1));
+  vocab_offset[0] = 0;
+  for (i = 0; i < params -> vocab; i++) {
+    wlen = 2 + (unsigned int) (nextRandom (&state) % 7);
+    pos = vocab_offset[i];
+    for (j = 0; j < wlen; j++) {
+      if (((j + i) & 1) == 0) {
+        vocab[pos++] = (unsigned char) consonants[nextRandom (&state) % (sizeof (consonants) - 1)];
+      }
+      else {
+        vocab[pos++] = (unsigned char) vowels[nextRandom (&state) % (sizeof (vowels) - 1)];
+      }
+    }
+    if (nextRandom (&state) % 3 == 0) {
+      suffix = gen_suffixes[nextRandom (&state) % (sizeof (gen_suffixes) / sizeof (gen_suffixes[0]))];
+      memcpy (vocab + pos, suffix, strlen (suffix));
+      pos += strlen (suffix);
+    }
+    vocab_offset[i + 1] = pos;
+  }
+
+  cdf = wmalloc (sizeof (double) * params -> vocab);
+  for (i = 0; i < params -> vocab; i++) {
+    total += 1.0 / pow ((double) (i + 1), params -> zipf);
+    cdf[i] = total;
+  }
+
+  text = wmalloc (sizeof (unsigned char) * (len + 1));
+  pos = 0;
+  while (pos < len) {
+    u = nextUniform (&state);
+    tag = (u < params -> tags);
+    if (tag == true) {
+      suffix = gen_tags[nextRandom (&state) % (sizeof (gen_tags) / sizeof (gen_tags[0]))];
+      token_len = (unsigned int) strlen (suffix);
+      memcpy (token, suffix, token_len);
+    }
+    else if (u < params -> tags + params -> long_tokens) {
+      token_len = GEN_LONG_LEN;
+      for (j = 0; j < token_len; j++) {
+        token[j] = (unsigned char) ('a' + nextRandom (&state) % 26);
+      }
+    }
+    else {
+      /*  Find the first word whose cumulative weight exceeds u  */
+      u = nextUniform (&state) * total;
+      lo = 0;
+      hi = params -> vocab - 1;
+      while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (cdf[mid] <= u) {
+          lo = mid + 1;
+        }
+        else {
+          hi = mid;
+        }
+      }
+      token_len = (unsigned int) (vocab_offset[lo + 1] - vocab_offset[lo]);
+      memcpy (token, vocab + vocab_offset[lo], token_len);
+
+      u = nextUniform (&state);
+      if (u < params -> all_caps) {
+        for (j = 0; j < token_len; j++) {
+          token[j] = (unsigned char) (token[j] - 'a' + 'A');
+        }
+      }
+      else if (u < params -> all_caps + params -> capitalized) {
+        token[0] = (unsigned char) (token[0] - 'a' + 'A');
+      }
+    }
+
+    /*  Half of the tags run into the next word  */
+    u = nextUniform (&state);
+    if ((tag == true) && (nextUniform (&state) < 0.5)) {
+      nonword = "";
+    }
+    else if (u < 0.80) {
+      nonword = " ";
+    }
+    else if (u < 0.88) {
+      nonword = ", ";
+    }
+    else if (u < 0.94) {
+      nonword = ". ";
+    }
+    else if (u < 0.98) {
+      nonword = "\n";
+    }
+    else {
+      nonword = " -- ";
+    }
+
+    for (j = 0; (j < token_len) && (pos < len); j++) {
+      text[pos++] = token[j];
+    }
+    for (j = 0; (nonword[j] != '\0') && (pos < len); j++) {
+      text[pos++] = (unsigned char) nonword[j];
+    }
+  }
+
+  wfree (cdf);
+  wfree (vocab_offset);
+  wfree (vocab);
+
+  return (text);
+}
+
+
+static double elapsedNs (const struct timespec *start, const struct timespec *end) {
+  return ((double) (end -> tv_sec - start -> tv_sec) * 1e9 + (double) (end -> tv_nsec - start -> tv_nsec));
+}
+
+
+/*  Print the throughput of a stage over bytes of text and its time
+**  per token  */
+static void report (const char *stage, size_t bytes, size_t ntokens, double ns) {
+  fprintf (stdout, "  %-18s %10.1f MB/s %10.1f ns/token\n", stage, ((double) bytes / 1048576.0) / (ns / 1e9), (ntokens == 0) ? 0.0 : ns / (double) ntokens);
+
+  return;
+}
+
+
+/*  Split the text into words, as the encoder does, and keep them  */
+static void collectWords (unsigned char *text, size_t len, BENCH_WORDS *words) {
+  unsigned char *src_p = text;
+  unsigned char *src_end = text + len;
+  unsigned char w[MAXWORDLEN];
+  unsigned int w_len = 0;
+  unsigned long long long_tokens = 0;
+  unsigned long long enforce_tags = 0;
+  size_t size = (len >> 2) + 1;
+  size_t pool_len = 0;
+  bool notdone = false;
+
+  words -> pool = wmalloc (sizeof (unsigned char) * (len + 1));
+  words -> offset = wmalloc (sizeof (size_t) * size);
+  words -> len = wmalloc (sizeof (unsigned int) * size);
+  words -> nwords = 0;
+
+  while (src_p != src_end) {
+    if (notdone == false) {
+      w_len = getWord (&src_p, src_end, w, MAXWORDLEN, &notdone, &long_tokens, &enforce_tags);
+      if (words -> nwords == size) {
+        size = size << 1;
+        words -> offset = wrealloc (words -> offset, sizeof (size_t) * size);
+        words -> len = wrealloc (words -> len, sizeof (unsigned int) * size);
+      }
+      memcpy (words -> pool + pool_len, w, (size_t) w_len);
+      words -> offset[words -> nwords] = pool_len;
+      words -> len[words -> nwords] = w_len;
+      words -> nwords++;
+      pool_len += w_len;
+    }
+    else {
+      notdone = false;
+    }
+    if ((notdone == false) && (src_p != src_end)) {
+      (void) getNonWord (&src_p, src_end, w, MAXWORDLEN, &notdone, &long_tokens);
+    }
+    else {
+      notdone = false;
+    }
+  }
+
+  words -> casefold = wmalloc (sizeof (unsigned int) * (words -> nwords + 1));
+  words -> stem = wmalloc (sizeof (unsigned int) * (words -> nwords + 1));
+
+  return;
+}
+
+
+/*
+**  Run every stage on a corpus of len bytes and report on each.  The
+**  stages which work on words (case-folding, stemming, unstemming and
+**  the lexicon) are timed on the words of the corpus, already split
+**  up; the others on the text or on the files encoded from it.  All
+**  times per token are per (word, nonword) record or per word.
+*/
+static void benchSize (const GEN_PARAMS *params, size_t len, unsigned char *base) {
+  FILE_STRUCT *file_info = NULL;
+  WORD_STRUCT *word_info = NULL;
+  NONWORD_STRUCT *nonword_info = NULL;
+  WORD_STRUCT lexicon;
+  NONWORD_STRUCT unused;
+  BENCH_WORDS words;
+  unsigned char *text = NULL;
+  unsigned char *src_p = NULL;
+  unsigned char *src_end = NULL;
+  unsigned char *folded = NULL;
+  unsigned char *stemmed = NULL;
+  unsigned char *stemmed_p = NULL;
+  unsigned char w[MAXSTEMLEN];
+  unsigned char pattern[CASEFOLD_PATTERN_MAX];
+  unsigned int *m = NULL;
+  unsigned int w_len = 0;
+  unsigned int checksum = 0;
+  unsigned long long long_tokens = 0;
+  unsigned long long enforce_tags = 0;
+  size_t nrecords = 0;
+  size_t i = 0;
+  bool notdone = false;
+  FILE *fp = NULL;
+  struct timespec start;
+  struct timespec end;
+
+  text = generateCorpus (params, len);
+  collectWords (text, len, &words);
+  fprintf (stdout, "Input:  %zu bytes, %zu words\n", len, words.nwords);
+
+  /*  Tokenizing alone, with the same calls as parseRecord  */
+  src_p = text;
+  src_end = text + len;
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  while (src_p != src_end) {
+    if (notdone == false) {
+      checksum += getWord (&src_p, src_end, w, MAXWORDLEN, &notdone, &long_tokens, &enforce_tags);
+    }
+    else {
+      notdone = false;
+    }
+    if ((notdone == false) && (src_p != src_end)) {
+      checksum += getNonWord (&src_p, src_end, w, MAXWORDLEN, &notdone, &long_tokens);
+    }
+    else {
+      notdone = false;
+    }
+    nrecords++;
+  }
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  report ("getWord/getNonWord", len, nrecords, elapsedNs (&start, &end));
+
+  /*  Case-folding, in place in a copy of the words  */
+  folded = wmalloc (sizeof (unsigned char) * (len + 1));
+  memcpy (folded, words.pool, len);
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  for (i = 0; i < words.nwords; i++) {
+    words.casefold[i] = casefold (folded + words.offset[i], words.len[i]);
+    if (words.casefold[i] == CASEFOLD_PATTERN) {
+      (void) casefoldPattern (folded + words.offset[i], words.len[i], pattern);
+    }
+  }
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  report ("casefold", len, words.nwords, elapsedNs (&start, &end));
+
+  /*  Stemming and unstemming, each including a copy of the word.
+  **  Stemming may add an 'e', so leave room for one per word.  */
+  m = wmalloc (sizeof (unsigned int) * MAXSTEMLEN);
+  stemmed = wmalloc (sizeof (unsigned char) * (len + words.nwords + 1));
+  stemmed_p = stemmed;
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  for (i = 0; i < words.nwords; i++) {
+    w_len = words.len[i];
+    memcpy (w, folded + words.offset[i], (size_t) w_len);
+    words.stem[i] = stem (w, &w_len, m);
+    memcpy (stemmed_p, w, (size_t) w_len);
+    words.len[i] = w_len;
+    words.offset[i] = (size_t) (stemmed_p - stemmed);
+    stemmed_p += w_len;
+  }
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  report ("stem", len, words.nwords, elapsedNs (&start, &end));
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  for (i = 0; i < words.nwords; i++) {
+    memcpy (w, stemmed + words.offset[i], (size_t) words.len[i]);
+    checksum += unstem (w, words.len[i], words.stem[i]);
+  }
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  report ("unstem", len, words.nwords, elapsedNs (&start, &end));
+
+  /*  Adding the stems to each kind of lexicon  */
+  initPrepair (&lexicon, &unused, MAXWORDLEN, false, false, false, false);
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  for (i = 0; i < words.nwords; i++) {
+    checksum += fcodeEncode (stemmed + words.offset[i], words.len[i], &lexicon.root_fc, lexicon.arena_fc, &lexicon.nwords, &lexicon.cmps, &lexicon.total_words_len);
+  }
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  report ("fcodeEncode", len, words.nwords, elapsedNs (&start, &end));
+  freeLexicons (&lexicon, &unused);
+
+  initPrepair (&lexicon, &unused, MAXWORDLEN, false, false, false, true);
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  for (i = 0; i < words.nwords; i++) {
+    checksum += fcodeHashEncode (stemmed + words.offset[i], words.len[i], lexicon.hash_fc, &lexicon.nwords, &lexicon.cmps, &lexicon.total_words_len);
+  }
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  report ("fcodeHashEncode", len, words.nwords, elapsedNs (&start, &end));
+  freeLexicons (&lexicon, &unused);
+
+  /*  Encoding to files, as prepair -e -c -s does, in stages  */
+  file_info = wmalloc (sizeof (FILE_STRUCT));
+  file_info -> verbose_level = false;
+  file_info -> compact_mods = false;
+  file_info -> flat_dicts = false;
+  file_info -> surface_forms = false;
+  file_info -> pack_container = false;
+  file_info -> seq_width = sizeof (unsigned int);
+  file_info -> bytes_in = 0;
+  file_info -> bytes_out = 0;
+  file_info -> mode = MODE_ENCODE;
+  word_info = wmalloc (sizeof (WORD_STRUCT));
+  nonword_info = wmalloc (sizeof (NONWORD_STRUCT));
+  openFiles (base, file_info, "w", false);
+  initPrepair (word_info, nonword_info, MAXWORDLEN, true, true, false, true);
+
+  fp = fmemopen (text, len, "r");
+  if (fp == NULL) {
+    fprintf (stderr, "Error opening the corpus as a stream (%s, line %u).\n", __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  fileEncode (file_info, fp, word_info, nonword_info);
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  fclose (fp);
+  report ("fileEncode", len, (size_t) word_info -> total_tokens, elapsedNs (&start, &end));
+
+  word_info -> map = wmalloc (word_info -> nwords * sizeof (unsigned int));
+  nonword_info -> map = wmalloc (nonword_info -> nnonwords * sizeof (unsigned int));
+  word_info -> map[0] = 0;
+  nonword_info -> map[0] = 0;
+  word_info -> dict_fc = wmalloc (word_info -> nwords * sizeof (FCODENODE));
+  nonword_info -> dict_fc = wmalloc (nonword_info -> nnonwords * sizeof (FCODENODE));
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  fcodeDictEncode (file_info, word_info -> root_fc, word_info -> hash_fc, word_info -> dict_fc, word_info -> map, false, word_info -> nwords, ISWORD);
+  fcodeDictEncode (file_info, nonword_info -> root_fc, nonword_info -> hash_fc, nonword_info -> dict_fc, nonword_info -> map, false, nonword_info -> nnonwords, ISNONWORD);
+  writeCasePatterns (file_info, word_info);
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  report ("fcodeDictEncode", len, (size_t) word_info -> total_tokens, elapsedNs (&start, &end));
+
+  /*  Most of closing is re-encoding the two sequences  */
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  closeFilesEncode (file_info, word_info -> map, nonword_info -> map);
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  report ("seqReEncode", len, (size_t) word_info -> total_tokens, elapsedNs (&start, &end));
+  freeLexicons (word_info, nonword_info);
+
+  /*  Decoding the files again  */
+  file_info -> mode = MODE_DECODE;
+  openFiles (base, file_info, "r", false);
+  initPrepair (word_info, nonword_info, MAXWORDLEN, false, false, false, true);
+  word_info -> pool_fc = wmalloc (sizeof (FCODEDICT));
+  word_info -> nwords = fcodeDictDecode (file_info, word_info -> pool_fc, ISWORD);
+  nonword_info -> pool_fc = wmalloc (sizeof (FCODEDICT));
+  nonword_info -> nnonwords = fcodeDictDecode (file_info, nonword_info -> pool_fc, ISNONWORD);
+  word_info -> case_fc = loadCasePatterns (file_info);
+
+  FOPEN ("/dev/null", fp, "w");
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  fileDecode (file_info, fp, word_info, nonword_info);
+  fflush (fp);
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  fclose (fp);
+  report ("fileDecode", len, file_info -> nsyms, elapsedNs (&start, &end));
+
+  closeFilesDecode (file_info, word_info, nonword_info);
+  freeLexicons (word_info, nonword_info);
+
+  /*  And again, from the surface forms (prepair -e -S)  */
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  surfaceEncode (base);
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  report ("surfaceEncode", len, file_info -> nsyms, elapsedNs (&start, &end));
+
+  openFiles (base, file_info, "r", false);
+  initPrepair (word_info, nonword_info, MAXWORDLEN, false, false, false, true);
+  word_info -> pool_fc = wmalloc (sizeof (FCODEDICT));
+  word_info -> nwords = fcodeDictDecode (file_info, word_info -> pool_fc, ISWORD);
+  nonword_info -> pool_fc = wmalloc (sizeof (FCODEDICT));
+  nonword_info -> nnonwords = fcodeDictDecode (file_info, nonword_info -> pool_fc, ISNONWORD);
+  word_info -> surface_fc = wmalloc (sizeof (FCODEDICT));
+  (void) fcodeDictDecodePart (file_info, file_info -> srf_name, word_info -> surface_fc);
+
+  FOPEN ("/dev/null", fp, "w");
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  fileDecode (file_info, fp, word_info, nonword_info);
+  fflush (fp);
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  fclose (fp);
+  report ("fileDecode -S", len, file_info -> nsyms, elapsedNs (&start, &end));
+
+  closeFilesDecode (file_info, word_info, nonword_info);
+  freeLexicons (word_info, nonword_info);
+
+  /*  And again, from a container (prepair -e -S -C)  */
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  containerPack (base);
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  report ("containerPack", len, file_info -> nsyms, elapsedNs (&start, &end));
+
+  openFiles (base, file_info, "r", false);
+  initPrepair (word_info, nonword_info, MAXWORDLEN, false, false, false, true);
+  word_info -> pool_fc = wmalloc (sizeof (FCODEDICT));
+  word_info -> nwords = fcodeDictDecode (file_info, word_info -> pool_fc, ISWORD);
+  nonword_info -> pool_fc = wmalloc (sizeof (FCODEDICT));
+  nonword_info -> nnonwords = fcodeDictDecode (file_info, nonword_info -> pool_fc, ISNONWORD);
+  word_info -> surface_fc = wmalloc (sizeof (FCODEDICT));
+  (void) fcodeDictDecodePart (file_info, file_info -> srf_name, word_info -> surface_fc);
+
+  FOPEN ("/dev/null", fp, "w");
+  clock_gettime (CLOCK_MONOTONIC, &start);
+  fileDecode (file_info, fp, word_info, nonword_info);
+  fflush (fp);
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  fclose (fp);
+  report ("fileDecode -S -C", len, file_info -> nsyms, elapsedNs (&start, &end));
+
+  freeLexicons (word_info, nonword_info);
+  closeFilesDecode (file_info, word_info, nonword_info);
+  removeFiles (base);
+
+  /*  Keep the results of the timed loops from being optimised away  */
+  fprintf (stdout, "  (checksum %u)\n\n", checksum);
+
+  wfree (nonword_info);
+  wfree (word_info);
+  wfree (file_info);
+  wfree (m);
+  wfree (stemmed);
+  wfree (folded);
+  wfree (words.stem);
+  wfree (words.casefold);
+  wfree (words.len);
+  wfree (words.offset);
+  wfree (words.pool);
+  wfree (text);
+
+  return;
+}
+
+
+static void removeFiles (unsigned char *base) {
+  static const char *extensions[] = { ".wd", ".ws", ".nwd", ".nws", ".cfm", ".cfx", ".sm", ".srf", ".ss", ".ppc" };
+  size_t len = strlen ((char*) base);
+  char *name = NULL;
+  unsigned int i = 0;
+
+  name = wmalloc (sizeof (char) * (len + 5));
+  for (i = 0; i < sizeof (extensions) / sizeof (extensions[0]); i++) {
+    memcpy (name, base, len);
+    memcpy (name + len, extensions[i], strlen (extensions[i]) + 1);
+    (void) unlink (name);
+  }
+  wfree (name);
+
+  return;
+}
+
+
+int main (int argc, char **argv) {
+  GEN_PARAMS params;
+  unsigned char *text = NULL;
+  unsigned char *base = (unsigned char*) "prepair-bench";
+  const char *sizes = BENCH_DEFAULT_SIZES;
+  char *sep = NULL;
+  size_t mb[BENCH_MAX_SIZES];
+  size_t nsizes = 0;
+  size_t gen_len = 0;
+  size_t i = 0;
+  bool generate = false;
+  int c;
+
+  params.seed = 1;
+  params.vocab = 50000;
+  params.zipf = 1.0;
+  params.capitalized = 0.10;
+  params.all_caps = 0.01;
+  params.tags = 0.02;
+  params.long_tokens = 0.001;
+
+#ifdef COUNT_MALLOC
+  initWMalloc ();
+#endif
+
+  while (true) {
+    c = getopt (argc, argv, "a:c:g:hi:l:n:r:t:V:z:?");
+    if (c == -1) {
+      break;
+    }
+
+    switch (c) {
+    case 'a':
+      params.all_caps = atof (optarg) / 100.0;
+      break;
+    case 'c':
+      params.capitalized = atof (optarg) / 100.0;
+      break;
+    case 'g':
+      gen_len = (size_t) strtoull (optarg, NULL, 10);
+      generate = true;
+      break;
+    case 'h':
+    case '?':
+      usage (argv[0]);
+      break;
+    case 'i':
+      base = (unsigned char*) optarg;
+      break;
+    case 'l':
+      params.long_tokens = atof (optarg) / 100.0;
+      break;
+    case 'n':
+      sizes = optarg;
+      break;
+    case 'r':
+      params.seed = (unsigned long long) strtoull (optarg, NULL, 10);
+      break;
+    case 't':
+      params.tags = atof (optarg) / 100.0;
+      break;
+    case 'V':
+      params.vocab = (unsigned int) atoi (optarg);
+      break;
+    case 'z':
+      params.zipf = atof (optarg);
+      break;
+    default:
+      fprintf (stderr, "Unexpected error:  getopt returned character code 0%d.\n", c);
+      return (EXIT_FAILURE);
+    }
+  }
+
+  if ((params.vocab == 0) || (params.zipf < 0.0) || (params.capitalized + params.all_caps > 1.0) || (params.tags + params.long_tokens > 1.0)) {
+    fprintf (stderr, "Invalid corpus settings; run %s -h for help (%s, line %u).\n", argv[0], __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+
+  if (generate == true) {
+    text = generateCorpus (&params, gen_len);
+    if (fwrite (text, sizeof (unsigned char), gen_len, stdout) != gen_len) {
+      fprintf (stderr, "Error writing the corpus (%s, line %u).\n", __FILE__, __LINE__);
+      exit (EXIT_FAILURE);
+    }
+    wfree (text);
+    return (EXIT_SUCCESS);
+  }
+
+  while ((*sizes != '\0') && (nsizes < BENCH_MAX_SIZES)) {
+    mb[nsizes] = (size_t) strtoull (sizes, &sep, 10);
+    if ((sep == sizes) || (mb[nsizes] == 0) || ((*sep != ',') && (*sep != '\0'))) {
+      fprintf (stderr, "The sizes must be given in MB, separated by commas (%s, line %u).\n", __FILE__, __LINE__);
+      exit (EXIT_FAILURE);
+    }
+    nsizes++;
+    sizes = (*sep == ',') ? sep + 1 : sep;
+  }
+
+  fprintf (stdout, "Vocabulary of %u words, Zipf exponent %.2f, seed %llu\n", params.vocab, params.zipf, params.seed);
+  fprintf (stdout, "Capitalized %.2f%%, uppercase %.2f%%, tags %.2f%%, long tokens %.2f%%\n\n", params.capitalized * 100.0, params.all_caps * 100.0, params.tags * 100.0, params.long_tokens * 100.0);
+  for (i = 0; i < nsizes; i++) {
+    benchSize (&params, mb[i] * 1048576, base);
+  }
+
+#ifdef COUNT_MALLOC
+  printWMalloc ();
+#endif
+
+  return (EXIT_SUCCESS);
+}
@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "common-def.h"
+#include "wmalloc.h"
+#include "prepair-defn.h"
+#include "fcode.h"
+#include "word.h"
+#include "nonword.h"
+#include "prepair.h"
+#include "modseq.h"
+#include "memencode.h"
+
+/*
+**  Test of the library:  encode the text in a file in memory with
+**  memEncode, with case-folding and stemming, and check that the
+**  sequences and dictionaries are those which prepair -e -c -s wrote
+**  for the same text.  Run by CTest (see CMakeLists.txt).
+*/
+
+static unsigned char *readText (const char *name, size_t *len);
+static void compareDict (const MEM_DICT *mem, const FCODEDICT *dict, const char *what);
+
+
+/*  Read all of the file name into memory  */
+static unsigned char *readText (const char *name, size_t *len) {
+  unsigned char *text = NULL;
+  size_t size = INIT_BUFF_SIZE;
+  size_t num_read = 0;
+  FILE *fp = NULL;
+
+  FOPEN (name, fp, "r");
+  text = wmalloc (sizeof (unsigned char) * size);
+  *len = 0;
+  while ((num_read = fread (text + *len, sizeof (unsigned char), size - *len, fp)) > 0) {
+    *len += num_read;
+    if (*len == size) {
+      size = size << 1;
+      text = wrealloc (text, sizeof (unsigned char) * size);
+    }
+  }
+  (void) fclose (fp);
+
+  return (text);
+}
+
+
+/*  Check that the dictionary built in memory has the entries of the
+**  one read from the files  */
+static void compareDict (const MEM_DICT *mem, const FCODEDICT *dict, const char *what) {
+  unsigned char *item = NULL;
+  unsigned int len = 0;
+  unsigned int i = 0;
+
+  if (mem -> nitems != dict -> nitems) {
+    fprintf (stderr, "The %s have %u entries in memory and %u in the files (%s, line %u).\n", what, mem -> nitems, dict -> nitems, __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+  for (i = FIRST_FCODE; i < mem -> nitems; i++) {
+    LOOKUPFCODE (dict, i, item, len);
+    if ((mem -> len[i] != len) || (memcmp (mem -> arena + mem -> offset[i], item, (size_t) len) != 0)) {
+      fprintf (stderr, "Entry %u of the %s differs (%s, line %u).\n", i, what, __FILE__, __LINE__);
+      exit (EXIT_FAILURE);
+    }
+  }
+
+  return;
+}
+
+
+int main (int argc, char **argv) {
+  FILE_STRUCT *file_info = NULL;
+  WORD_STRUCT *word_info = NULL;
+  NONWORD_STRUCT *nonword_info = NULL;
+  FCODEDICT *words = NULL;
+  FCODEDICT *nonwords = NULL;
+  FCODEDICT *cases = NULL;
+  MEM_STREAM stream;
+  unsigned char *text = NULL;
+  size_t len = 0;
+  size_t i = 0;
+
+  if (argc != 3) {
+    fprintf (stderr, "Usage:  %s <base filename> <text file>\n", argv[0]);
+    exit (EXIT_FAILURE);
+  }
+
+#ifdef COUNT_MALLOC
+  initWMalloc ();
+#endif
+
+  text = readText (argv[2], &len);
+  word_info = wmalloc (sizeof (WORD_STRUCT));
+  nonword_info = wmalloc (sizeof (NONWORD_STRUCT));
+  initPrepair (word_info, nonword_info, MAXWORDLEN, true, true, false, true);
+  memEncode (text, len, word_info, nonword_info, &stream);
+
+  file_info = wmalloc (sizeof (FILE_STRUCT));
+  memset (file_info, 0, sizeof (FILE_STRUCT));
+  file_info -> mode = MODE_DECODE;
+  openFiles ((unsigned char*) argv[1], file_info, "r", false);
+
+  if (stream.nsyms != file_info -> nsyms) {
+    fprintf (stderr, "%zu records in memory and %zu in the files (%s, line %u).\n", stream.nsyms, file_info -> nsyms, __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+  for (i = 0; i < stream.nsyms; i++) {
+    if (((stream.ws[i] & SYMSEQ_WORD_MASK) != GETSYMBOL (&file_info -> ws_sym, i)) ||
+        (stream.cfm[i] != GETMODIFIER (&file_info -> cfm_mod, i)) ||
+        (stream.sm[i] != GETMODIFIER (&file_info -> sm_mod, i)) ||
+        (stream.nws[i] != GETSYMBOL (&file_info -> nws_sym, i))) {
+      fprintf (stderr, "Record %zu differs (%s, line %u).\n", i, __FILE__, __LINE__);
+      exit (EXIT_FAILURE);
+    }
+  }
+
+  words = wmalloc (sizeof (FCODEDICT));
+  (void) fcodeDictDecode (file_info, words, ISWORD);
+  compareDict (&stream.words, words, "words");
+  nonwords = wmalloc (sizeof (FCODEDICT));
+  (void) fcodeDictDecode (file_info, nonwords, ISNONWORD);
+  compareDict (&stream.nonwords, nonwords, "nonwords");
+  cases = loadCasePatterns (file_info);
+  if (cases != NULL) {
+    compareDict (&stream.cases, cases, "patterns of case");
+    fcodeDictFree (cases);
+  }
+  else if (stream.cases.nitems != FIRST_FCODE) {
+    fprintf (stderr, "There are patterns of case in memory but not in the files (%s, line %u).\n", __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+  fcodeDictFree (nonwords);
+  fcodeDictFree (words);
+
+  closeFilesDecode (file_info, word_info, nonword_info);
+  memStreamFree (&stream);
+  freeLexicons (word_info, nonword_info);
+  wfree (file_info);
+  wfree (nonword_info);
+  wfree (word_info);
+  wfree (text);
+
+  return (EXIT_SUCCESS);
+}
@@ -3,7 +3,9 @@
 #include <math.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <limits.h>
 #include <stdbool.h>
 
@@ -15,10 +17,23 @@
 #include "word.h"
 #include "nonword.h"
 #include "prepair.h"
+#include "mtencode.h"
+#include "stats.h"
+#include "surface.h"
+#include "container.h"
 
 /*  Pull the configuration file in  */
 #include "PrePairConfig.h"
 
+/*  Value returned by getopt_long for --stats-json, outside the range
+**  of the short options  */
+#define OPT_STATS_JSON 256
+
+static struct option long_options[] = {
+  { "stats-json", required_argument, NULL, OPT_STATS_JSON },
+  { NULL, 0, NULL, 0 }
+};
+
 
 static void usage (char *progname) {
   fprintf (stderr, "Pre-pair (Re-Pair Word-based Pre-processor)\n");
@@ -26,21 +41,30 @@ static void usage (char *progname) {
   fprintf (stderr, "Usage: %s [-d | -e | -n | -l] [options] <input >output\n", progname);
   fprintf (stderr, "Options:\n");
   fprintf (stderr, "-c\t: Perform case folding.\n");
+  fprintf (stderr, "-C\t: Pack the files into a single container (.ppc) once they are\n\t  written (encoding).  Decoding reads the container if it exists.\n");
   fprintf (stderr, "-d\t: Decode.\n");
   fprintf (stderr, "-e\t: Encode.\n");
   fprintf (stderr, "-n\t: Decode with no stemming / case-folding.\n");
   fprintf (stderr, "-l\t: Decode for comparison with Link-Grammar.\n");
   fprintf (stderr, "-h/-?\t: Display this message\n");
   fprintf (stderr, "-i\t: Base filename required for naming output files (encoding)\n\t  or input files (decoding).\n");
-  fprintf (stderr, "-m\t: Maximum string length, at most %u because of front coding.\n", MAXWORDLEN);
+  fprintf (stderr, "-m\t: Maximum string length, at most %u [default].\n", MAXWORDLEN);
+  fprintf (stderr, "-M\t: Store the dictionaries (.wd and .nwd) flat, with an offset\n\t  table, so that decoding can map them without parsing (encoding).\n");
   fprintf (stderr, "-p\t: Print sorted words to stdout.\n");
+  fprintf (stderr, "-r\t: Decode only the records start:count (e.g., -r 1000:50).\n");
   fprintf (stderr, "-s\t: Perform stemming.\n");
+  fprintf (stderr, "-S\t: Also write the surface form of each word (.srf and .ss), so\n\t  that decoding needs no unstemming or un-case-folding (encoding).\n");
+  fprintf (stderr, "-t\t: Number of threads used for encoding or decoding (default: 1).\n");
+  fprintf (stderr, "-T\t: Use splay trees for the lexicons instead of hash tables.\n");
   fprintf (stderr, "-v\t: Verbose output\n");
-  fprintf (stderr, "\nDictionary encoding settings (compile-time):\n");
+  fprintf (stderr, "-w\t: Bits in a record of the sequences (.ws and .nws):  32\n\t  [default] or 40 (encoding).  Either way, there can be at most\n\t  2^32 distinct words (2^31 in builds with FLAG_WORDS).\n");
+  fprintf (stderr, "--stats-json FILE\n\t: Write the time taken by each phase, the bytes of text and the\n\t  sizes of the files, the peak memory and the counters of the run\n\t  to FILE as JSON.\n");
+  fprintf (stderr, "-z\t: Store the modifier files (.cfm and .sm) as a table of\n\t  distinct values and narrow indices (encoding).\n");
+  fprintf (stderr, "\nDictionary encoding settings:\n");
   fprintf (stderr, "\tWords are encoded using ");
-  fprintf (stderr, "no coding.\n");
+  fprintf (stderr, "front coding, or flat with -M.\n");
   fprintf (stderr, "\tNonwords are encoded using ");
-  fprintf (stderr, "no coding.\n");
+  fprintf (stderr, "front coding, or flat with -M.\n");
   fprintf (stderr, "\nThe input text file is from stdin.\n");
   fprintf (stderr, "The output text file is sent to stdout.\n\n");
   
@@ -53,9 +77,16 @@ int main (int argc, char **argv) {
   char *progname = argv[0];
   unsigned char *filename = NULL;
   bool verbose_level = false;
+  bool compact_mods = false;
+  bool flat_dicts = false;
+  bool surface_forms = false;
+  bool pack_container = false;
+  unsigned int seq_width = sizeof (unsigned int);
   FILE_STRUCT *file_info = NULL;
   WORD_STRUCT *word_info = NULL;
   NONWORD_STRUCT *nonword_info = NULL;
+  char *stats_name = NULL;
+  STATS_STRUCT stats;
 
   int c;
   enum PROGMODE mode = 0;
@@ -65,13 +96,24 @@ int main (int argc, char **argv) {
   unsigned int maxword = MAXWORDLEN;
   bool dostem = false;
   bool printsorted = false;
+  bool usehash = true;
+  unsigned int nthreads = 1;
+  bool dorange = false;
+  size_t range_start = 0;
+  size_t range_count = 0;
+  char *range_sep = NULL;
+  char *range_end = NULL;
+
+#ifdef COUNT_MALLOC
+  initWMalloc ();
+#endif
 
   if (argc == 1) {
     usage (progname);
   }
 
   while (true) {
-    c = getopt (argc, argv, "cdehi:lm:npsv?");
+    c = getopt_long (argc, argv, "cCdehi:lm:Mnpr:sSt:Tvw:z?", long_options, NULL);
     if (c == EOF) {
       break;
     }
@@ -80,6 +122,9 @@ int main (int argc, char **argv) {
     case 'c':
       docasefold = true;
       break;
+    case 'C':
+      pack_container = true;
+      break;
     case 'd':
       if (mode != MODE_NONE) {
         fprintf (stderr, "Please choose one of -e, -d, -n, or -l.\n");
@@ -109,6 +154,9 @@ int main (int argc, char **argv) {
         exit (EXIT_FAILURE);
       }
       break;
+    case 'M':
+      flat_dicts = true;
+      break;
     case 'l':
       if (mode != MODE_NONE) {
         fprintf (stderr, "Please choose one of -e, -d, -n, or -l.\n");
@@ -126,12 +174,55 @@ int main (int argc, char **argv) {
     case 'p':
       printsorted = true;
       break;
+    case 'r':
+      /*  strtoul would accept a sign or leading spaces, so both numbers
+      **  must begin with a digit  */
+      errno = 0;
+      range_start = (size_t) strtoul (optarg, &range_sep, 10);
+      if ((isdigit ((unsigned char) optarg[0]) == 0) || (*range_sep != ':') || (errno != 0)) {
+        fprintf (stderr, "The range must be given as start:count (%s, line %u).\n", __FILE__, __LINE__);
+        exit (EXIT_FAILURE);
+      }
+      range_count = (size_t) strtoul (range_sep + 1, &range_end, 10);
+      if ((isdigit ((unsigned char) range_sep[1]) == 0) || (*range_end != '\0') || (errno != 0)) {
+        fprintf (stderr, "The range must be given as start:count (%s, line %u).\n", __FILE__, __LINE__);
+        exit (EXIT_FAILURE);
+      }
+      dorange = true;
+      break;
     case 's':
       dostem = true;
       break;
+    case 'S':
+      surface_forms = true;
+      break;
+    case 't':
+      nthreads = (unsigned int) atoi (optarg);
+      if ((nthreads < 1) || (nthreads > MAX_THREADS)) {
+        fprintf (stderr, "The number of threads must be between 1 and %u, inclusive. (%s, line %u)\n", MAX_THREADS, __FILE__, __LINE__);
+        exit (EXIT_FAILURE);
+      }
+      break;
+    case 'T':
+      usehash = false;
+      break;
     case 'v':
       verbose_level = true;
       break;
+    case 'w':
+      seq_width = (unsigned int) atoi (optarg);
+      if ((seq_width != 32) && (seq_width != 40)) {
+        fprintf (stderr, "The bits in a sequence record must be 32 or 40 (%s, line %u).\n", __FILE__, __LINE__);
+        exit (EXIT_FAILURE);
+      }
+      seq_width = seq_width / 8;
+      break;
+    case 'z':
+      compact_mods = true;
+      break;
+    case OPT_STATS_JSON:
+      stats_name = optarg;
+      break;
     default:
       fprintf (stderr, "Unexpected error:  getopt returned character code 0%d.\n", c);
       return (EXIT_FAILURE);
@@ -155,19 +246,43 @@ int main (int argc, char **argv) {
     fprintf (stderr, "Please specify one of -e, -d, -n, or -l (%s, line %u).\n", __FILE__, __LINE__);
     exit (EXIT_FAILURE);
   }
+  if ((dorange == true) && (mode == MODE_ENCODE)) {
+    fprintf (stderr, "A range (-r) can only be given when decoding (%s, line %u).\n", __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+  if ((mode == MODE_ENCODE) && (nthreads > 1) && (usehash == false)) {
+    fprintf (stderr, "Multithreaded encoding requires the hash lexicons; -t cannot be used with -T (%s, line %u).\n", __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
 
   file_info = wmalloc (sizeof (FILE_STRUCT));
   file_info -> verbose_level = verbose_level;
+  file_info -> compact_mods = compact_mods;
+  file_info -> flat_dicts = flat_dicts;
+  file_info -> surface_forms = surface_forms;
+  file_info -> pack_container = pack_container;
+  file_info -> seq_width = seq_width;
+  file_info -> bytes_in = 0;
+  file_info -> bytes_out = 0;
   file_info -> mode = mode;
+  statsInit (&stats);
 
   openFiles (filename, file_info, (mode == MODE_ENCODE ? "w" : "r"), false);
 
   word_info = wmalloc (sizeof (WORD_STRUCT));
   nonword_info = wmalloc (sizeof (NONWORD_STRUCT));
-  initPrepair (word_info, nonword_info, maxword, docasefold, dostem, printsorted);
+  initPrepair (word_info, nonword_info, maxword, docasefold, dostem, printsorted, usehash);
+  word_info -> sample_phases = (stats_name != NULL) ? true : false;
 
   if (mode == MODE_ENCODE) {
-    fileEncode (file_info, stdin, word_info, nonword_info);
+    statsStart (&stats);
+    if (nthreads > 1) {
+      fileEncodeThreaded (file_info, stdin, word_info, nonword_info, nthreads);
+    }
+    else {
+      fileEncodePipelined (file_info, stdin, word_info, nonword_info);
+    }
+    statsStop (&stats, STATS_ENCODE);
 
     word_info -> map = wmalloc (word_info -> nwords * sizeof (unsigned int));
     nonword_info -> map = wmalloc (nonword_info -> nnonwords * sizeof (unsigned int));
@@ -176,11 +291,14 @@ int main (int argc, char **argv) {
     word_info -> map[0] = 0;
     nonword_info -> map[0] = 0;
 
+    statsStart (&stats);
     word_info -> dict_fc = wmalloc (word_info -> nwords * sizeof (FCODENODE));
-    fcodeDictEncode (file_info, word_info -> root_fc, word_info -> dict_fc, word_info -> map, word_info -> printsorted, word_info -> nwords, ISWORD);
+    fcodeDictEncode (file_info, word_info -> root_fc, word_info -> hash_fc, word_info -> dict_fc, word_info -> map, word_info -> printsorted, word_info -> nwords, ISWORD);
 
     nonword_info -> dict_fc = wmalloc (nonword_info -> nnonwords * sizeof (FCODENODE));
-    fcodeDictEncode (file_info, nonword_info -> root_fc, nonword_info -> dict_fc, nonword_info -> map, nonword_info -> printsorted, nonword_info -> nnonwords, ISNONWORD);
+    fcodeDictEncode (file_info, nonword_info -> root_fc, nonword_info -> hash_fc, nonword_info -> dict_fc, nonword_info -> map, nonword_info -> printsorted, nonword_info -> nnonwords, ISNONWORD);
+    writeCasePatterns (file_info, word_info);
+    statsStop (&stats, STATS_DICT_WRITE);
 
   /* Write some overall statistics */
     if (file_info -> verbose_level == true) {
@@ -202,51 +320,100 @@ int main (int argc, char **argv) {
 #else
     fprintf (stderr, "        for word-based Re-Pair.\n");
 #endif
-      fprintf (stderr, "Words were literal-coded.\n");
-      fprintf (stderr, "\t%6u word tokens found, of which\n", word_info -> total_tokens);
-      fprintf (stderr, "\t\t%6u word tokens were longer than %u characters\n", word_info -> long_tokens, MAXWORDLEN);
-      fprintf (stderr, "\t\t%6u word tokens broken because of tags\n", word_info -> enforce_tags);
-      fprintf (stderr, "\t\t%6u word tokens were zero-length\n", word_info -> zerolength_sym);
-      fprintf (stderr, "\t%6.3f characters in length in message (average)\n", (float) word_info -> total_length / (float) word_info -> total_tokens);
-      fprintf (stderr, "\t%6.3f characters in length in lexicon (average)\n", (float) word_info -> total_words_len / (float) word_info -> nwords);
+      fprintf (stderr, "Words were %s.\n", (file_info -> flat_dicts == true) ? "stored flat" : "front-coded");
+      fprintf (stderr, "\t%6llu word tokens found, of which\n", word_info -> total_tokens);
+      fprintf (stderr, "\t\t%6llu word tokens were longer than %u characters\n", word_info -> long_tokens, word_info -> maxword);
+      fprintf (stderr, "\t\t%6llu word tokens broken because of tags\n", word_info -> enforce_tags);
+      fprintf (stderr, "\t\t%6llu word tokens were zero-length\n", word_info -> zerolength_sym);
+      fprintf (stderr, "\t\t%6llu word tokens were found in the stem cache\n", word_info -> cache_hits);
+      fprintf (stderr, "\t%6.3f characters in length in message (average)\n", (double) word_info -> total_length / (double) word_info -> total_tokens);
+      fprintf (stderr, "\t%6.3f characters in length in lexicon (average)\n", (double) word_info -> total_words_len / (double) word_info -> nwords);
       fprintf (stderr, "\t%6u unique word tokens (incl. 0-length word)\n", word_info -> nwords);
       fprintf (stderr, "\t%6.2f average comparisons for each identified word\n", (double)(word_info -> cmps)/(word_info -> total_tokens));
+      fprintf (stderr, "\t%6.2f average comparisons in the stem cache for each word\n", (double) (word_info -> cache_cmps) / (word_info -> total_tokens));
     }
 
     if (file_info -> verbose_level == true) {
-      fprintf (stderr, "Nonwords were literal-coded.\n");
-      fprintf (stderr, "\t%6u nonword tokens found, of which\n", nonword_info -> total_tokens);
-      fprintf (stderr, "\t\t%6u nonword tokens were longer than %u characters\n", nonword_info -> long_tokens, MAXWORDLEN);
-      fprintf (stderr, "\t\t%6u nonword tokens broken because of tags\n", nonword_info -> enforce_tags);
-      fprintf (stderr, "\t\t%6u nonword tokens were zero-length\n", nonword_info -> zerolength_sym);
+      fprintf (stderr, "Nonwords were %s.\n", (file_info -> flat_dicts == true) ? "stored flat" : "front-coded");
+      fprintf (stderr, "\t%6llu nonword tokens found, of which\n", nonword_info -> total_tokens);
+      fprintf (stderr, "\t\t%6llu nonword tokens were longer than %u characters\n", nonword_info -> long_tokens, nonword_info -> maxnonword);
+      fprintf (stderr, "\t\t%6llu nonword tokens broken because of tags\n", nonword_info -> enforce_tags);
+      fprintf (stderr, "\t\t%6llu nonword tokens were zero-length\n", nonword_info -> zerolength_sym);
       fprintf (stderr, "\t\t\t(may be 1 larger than expected,\n\t\t\tif file ended with a word)\n");
-      fprintf (stderr, "\t%6.3f characters in length in message (average)\n", (float) nonword_info -> total_length / (float) nonword_info -> total_tokens);
-      fprintf (stderr, "\t%6.3f characters in length in lexicon (average)\n", (float) nonword_info -> total_nonwords_len / (float) nonword_info -> nnonwords);
+      fprintf (stderr, "\t%6.3f characters in length in message (average)\n", (double) nonword_info -> total_length / (double) nonword_info -> total_tokens);
+      fprintf (stderr, "\t%6.3f characters in length in lexicon (average)\n", (double) nonword_info -> total_nonwords_len / (double) nonword_info -> nnonwords);
       fprintf (stderr, "\t%6u unique nonword tokens (incl. 0-length nonword)\n", nonword_info -> nnonwords);
       fprintf (stderr, "\t%6.2f average comparisons for each identified nonword\n", (double)(nonword_info -> cmps)/(nonword_info -> total_tokens));
     }
 
+    statsStart (&stats);
     closeFilesEncode (file_info, word_info -> map, nonword_info -> map);
+    statsStop (&stats, STATS_SEQ_REMAP);
+
+    if (file_info -> surface_forms == true) {
+      statsStart (&stats);
+      surfaceEncode (filename);
+      statsStop (&stats, STATS_SURFACE);
+    }
+
+    if (file_info -> pack_container == true) {
+      statsStart (&stats);
+      containerPack (filename);
+      statsStop (&stats, STATS_CONTAINER);
+    }
   }
   else {
-    word_info -> nwords = INIT_FCODE_SIZE;
-    nonword_info -> nnonwords = INIT_FCODE_SIZE;
+    statsStart (&stats);
+    word_info -> pool_fc = wmalloc (sizeof (FCODEDICT));
+    word_info -> nwords = fcodeDictDecode (file_info, word_info -> pool_fc, ISWORD);
 
-    word_info -> dict_fc = wmalloc ((word_info -> nwords) * sizeof (FCODENODE));
-    word_info -> nwords = fcodeDictDecode (file_info, &word_info -> dict_fc, word_info -> nwords, ISWORD);
+    nonword_info -> pool_fc = wmalloc (sizeof (FCODEDICT));
+    nonword_info -> nnonwords = fcodeDictDecode (file_info, nonword_info -> pool_fc, ISNONWORD);
 
-    nonword_info -> dict_fc = wmalloc ((nonword_info -> nnonwords) * sizeof (FCODENODE));
-    nonword_info -> nnonwords = fcodeDictDecode (file_info, &nonword_info -> dict_fc, nonword_info -> nnonwords, ISNONWORD);
+    /*  Only plain decoding writes words with their modifiers undone  */
+    if ((mode == MODE_DECODE) && (file_info -> has_surface == true)) {
+      word_info -> surface_fc = wmalloc (sizeof (FCODEDICT));
+      (void) fcodeDictDecodePart (file_info, file_info -> srf_name, word_info -> surface_fc);
+    }
+    else if (mode == MODE_DECODE) {
+      word_info -> case_fc = loadCasePatterns (file_info);
+    }
+    statsStop (&stats, STATS_DICT_LOAD);
 
-    fileDecode (file_info, stdout, word_info, nonword_info);
+    statsStart (&stats);
+    if (nthreads > 1) {
+      if (dorange == false) {
+        range_start = 0;
+        range_count = file_info -> nsyms;
+      }
+      fileDecodeThreaded (file_info, stdout, word_info, nonword_info, range_start, range_count, nthreads);
+    }
+    else if (dorange == true) {
+      fileDecodeRange (file_info, stdout, word_info, nonword_info, range_start, range_count);
+    }
+    else {
+      fileDecode (file_info, stdout, word_info, nonword_info);
+    }
+    statsStop (&stats, STATS_DECODE);
 
     closeFilesDecode (file_info, word_info, nonword_info);
   }
 
+  if (stats_name != NULL) {
+    statsWriteJson (stats_name, &stats, filename, file_info, word_info, nonword_info, nthreads);
+  }
+
+  freeLexicons (word_info, nonword_info);
   wfree (nonword_info);
   wfree (word_info);
   wfree (file_info);
   wfree (filename);
 
+#ifdef COUNT_MALLOC
+  if (verbose_level == true) {
+    printWMalloc ();
+  }
+#endif
+
   return (EXIT_SUCCESS);
 }
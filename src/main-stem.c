@@ -3,6 +3,10 @@
 #include <ctype.h>
 #include <string.h>
 #include <limits.h>
+#include <time.h>
+#if defined (__x86_64__) || defined (__i386__)
+#include <x86intrin.h>
+#endif
 
 #include "common-def.h"
 #include "wmalloc.h"
@@ -13,21 +17,29 @@
 /*  Pull the configuration file in  */
 #include "PrePairConfig.h"
 
+/*  Number of times the words are stemmed by the benchmark  */
+#define BENCH_PASSES 10
+
 static void usage (char *progname);
+static void benchmark (void);
 
 static void usage (char *progname) {
   fprintf (stderr, "Stem/Case-fold test program\n");
   fprintf (stderr, "===========================\n\n");
   fprintf (stderr, "Usage:  %s <input >output\n", progname);
   fprintf (stderr, "  or\n");
-  fprintf (stderr, "        %s <word> >output\n\n", progname);
+  fprintf (stderr, "        %s <word> >output\n", progname);
+  fprintf (stderr, "  or\n");
+  fprintf (stderr, "        %s -b <input\n\n", progname);
   fprintf (stderr, "Either apply stemming and case-folding to a document\n");
   fprintf (stderr, "given via stdin, or stem one word at the command line\n");
   fprintf (stderr, "If the first case is chosen, then something is sent\n");
   fprintf (stderr, "to stdout only if a difference occurs between encoding\n");
   fprintf (stderr, "and decoding.  If the second case is chosen, output\n");
   fprintf (stderr, "is always provided.  Words must not be longer than\n");
-  fprintf (stderr, "MAXSTEMLEN characters in length.\n\n");
+  fprintf (stderr, "MAXSTEMLEN characters in length.  With -b, the words\n");
+  fprintf (stderr, "of the input are stemmed %u times and the time taken\n", BENCH_PASSES);
+  fprintf (stderr, "per word is reported.\n\n");
   fprintf (stderr, "This message is displayed if only either the option\n");
   fprintf (stderr, "-? or -h is given.\n\n");
   
@@ -36,6 +48,99 @@ static void usage (char *progname) {
   exit (EXIT_SUCCESS);
 }
 
+/*
+**  Stem every word read from stdin BENCH_PASSES times and report the
+**  average time (and, on x86, the number of cycles) spent on a word.
+**  The words are read into memory first so that only the stemmer and
+**  the copy of each word into a scratch buffer are timed.
+*/
+static void benchmark (void) {
+  unsigned char *words = NULL;
+  unsigned int *lens = NULL;
+  unsigned char *curr = NULL;
+  unsigned int *m = NULL;
+  unsigned char initial[256];
+  unsigned char pattern[CASEFOLD_PATTERN_MAX];
+  size_t words_size = 1048576;
+  size_t words_used = 0;
+  size_t nwords = 0;
+  size_t lens_size = 65536;
+  size_t i = 0;
+  size_t pos = 0;
+  unsigned int pass = 0;
+  unsigned int len = 0;
+  unsigned int checksum = 0;
+  struct timespec start;
+  struct timespec end;
+  double ns = 0.0;
+#if defined (__x86_64__) || defined (__i386__)
+  unsigned long long cycles = 0;
+#endif
+
+  words = wmalloc (sizeof (unsigned char) * words_size);
+  lens = wmalloc (sizeof (unsigned int) * lens_size);
+  curr = wmalloc (sizeof (unsigned char) * MAXSTEMLEN);
+  m = wmalloc (sizeof (unsigned int) * MAXSTEMLEN);
+
+  while (fscanf (stdin, "%255s", (char*) initial) != EOF) {
+    len = (unsigned int) strlen ((char*) initial);
+    if (casefold (initial, len) == CASEFOLD_PATTERN) {
+      (void) casefoldPattern (initial, len, pattern);
+    }
+    if (words_used + len > words_size) {
+      words_size *= 2;
+      words = wrealloc (words, sizeof (unsigned char) * words_size);
+    }
+    if (nwords == lens_size) {
+      lens_size *= 2;
+      lens = wrealloc (lens, sizeof (unsigned int) * lens_size);
+    }
+    memcpy (words + words_used, initial, len);
+    words_used += len;
+    lens[nwords] = len;
+    nwords++;
+  }
+
+  if (nwords == 0) {
+    fprintf (stderr, "No words to stem.\n");
+    exit (EXIT_FAILURE);
+  }
+
+  clock_gettime (CLOCK_MONOTONIC, &start);
+#if defined (__x86_64__) || defined (__i386__)
+  cycles = __rdtsc ();
+#endif
+  for (pass = 0; pass < BENCH_PASSES; pass++) {
+    pos = 0;
+    for (i = 0; i < nwords; i++) {
+      len = lens[i];
+      memcpy (curr, words + pos, len);
+      pos += len;
+      checksum += stem (curr, &len, m) + len;
+    }
+  }
+#if defined (__x86_64__) || defined (__i386__)
+  cycles = __rdtsc () - cycles;
+#endif
+  clock_gettime (CLOCK_MONOTONIC, &end);
+
+  ns = ((double) (end.tv_sec - start.tv_sec) * 1e9 + (double) (end.tv_nsec - start.tv_nsec)) / ((double) nwords * BENCH_PASSES);
+  fprintf (stderr, "Words:  %zu (x %u passes)\n", nwords, BENCH_PASSES);
+  fprintf (stderr, "Time per word:  %.1f ns\n", ns);
+#if defined (__x86_64__) || defined (__i386__)
+  fprintf (stderr, "Cycles per word:  %.1f (reference cycles)\n", (double) cycles / ((double) nwords * BENCH_PASSES));
+#endif
+  fprintf (stderr, "Checksum:  %u\n", checksum);
+
+  wfree (m);
+  wfree (curr);
+  wfree (lens);
+  wfree (words);
+
+  return;
+}
+
+
 int main (int argc, char *argv[]) {
   unsigned char *curr;
   unsigned char *initial;
@@ -45,6 +150,8 @@ int main (int argc, char *argv[]) {
   unsigned int case_modifier = 0;
   unsigned int len = 0;
   unsigned int old_len = 0;
+  unsigned char pattern[CASEFOLD_PATTERN_MAX];
+  unsigned int pattern_len = 0;
 
   unsigned char *temp;
 
@@ -58,18 +165,31 @@ int main (int argc, char *argv[]) {
     usage (argv[0]);
   }
 
+  if ((argc == 2) && (strcmp ("-b", argv[1]) == 0)) {
+    benchmark ();
+    return (EXIT_SUCCESS);
+  }
+
   if (argc != 2) {
     while (fscanf (stdin, "%255s", (char*) initial) != EOF) {
       curr = (unsigned char*) strcpy ((char*) curr, (char*) initial);
       old_len = (unsigned int) strlen ((char*) curr);
       case_modifier = casefold (curr, old_len);
+      if (case_modifier == CASEFOLD_PATTERN) {
+        pattern_len = casefoldPattern (curr, old_len, pattern);
+      }
       modifier = stem (curr, &old_len, m);
       curr[old_len] = (unsigned char) '\0';
       ustrncpy (temp, curr, old_len);
       temp[old_len] = (unsigned char) '\0';
       len = unstem (curr, old_len, modifier);
       curr[len] = (unsigned char) '\0';
-      uncasefold (curr, len, case_modifier);
+      if (case_modifier == CASEFOLD_PATTERN) {
+        uncasefoldPattern (curr, len, pattern, pattern_len);
+      }
+      else {
+        uncasefold (curr, len, case_modifier);
+      }
       ustrncpy (final, curr, len);
       final[len] = (unsigned char) '\0';
       if (strcmp ((char*) initial, (char*) final) != 0) {
@@ -82,12 +202,20 @@ int main (int argc, char *argv[]) {
     curr = (unsigned char*) strcpy ((char*) curr, argv[1]);
     old_len = (unsigned int) strlen ((char*) curr);
     case_modifier = casefold (curr, old_len);
+    if (case_modifier == CASEFOLD_PATTERN) {
+      pattern_len = casefoldPattern (curr, old_len, pattern);
+    }
     modifier = stem (curr, &old_len, m);
     curr[old_len] = (unsigned char) '\0';
     ustrncpy (temp, curr, old_len);
     temp[old_len] = (unsigned char) '\0';
     len = unstem (curr, old_len, modifier);
-    uncasefold (curr, len, case_modifier);
+    if (case_modifier == CASEFOLD_PATTERN) {
+      uncasefoldPattern (curr, len, pattern, pattern_len);
+    }
+    else {
+      uncasefold (curr, len, case_modifier);
+    }
     ustrncpy (final, curr, len);
     final[len] = (unsigned char) '\0';
     fprintf (stderr, "%s --%s[%u, %u]--> %s\n", (char*) initial, (char*) temp, modifier, case_modifier, (char*) final);
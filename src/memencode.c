@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "common-def.h"
+#include "wmalloc.h"
+#include "prepair-defn.h"
+#include "fcode.h"
+#include "word.h"
+#include "nonword.h"
+#include "prepair.h"
+#include "memencode.h"
+
+/*  getWord may look up to this many bytes past the end of the text  */
+#define MEM_LOOKAHEAD 4
+
+
+/*  Append one record to the sequences of stream, enlarging them if
+**  necessary  */
+static void appendRecord (MEM_STREAM *stream, unsigned int wrd_key, unsigned int casefold_result, unsigned int stem_result, unsigned int nonwrd_key) {
+  if (stream -> nsyms == stream -> size) {
+    stream -> size = stream -> size << 1;
+    stream -> ws = wrealloc (stream -> ws, sizeof (unsigned int) * stream -> size);
+    stream -> cfm = wrealloc (stream -> cfm, sizeof (unsigned int) * stream -> size);
+    stream -> sm = wrealloc (stream -> sm, sizeof (unsigned int) * stream -> size);
+    stream -> nws = wrealloc (stream -> nws, sizeof (unsigned int) * stream -> size);
+  }
+
+  stream -> ws[stream -> nsyms] = wrd_key;
+  stream -> cfm[stream -> nsyms] = casefold_result;
+  stream -> sm[stream -> nsyms] = stem_result;
+  stream -> nws[stream -> nsyms] = nonwrd_key;
+  (stream -> nsyms)++;
+
+  return;
+}
+
+
+/*
+**  Sort the lexicon, copy it into dict as one arena and re-encode the
+**  sequence seq of length n with the sorted ids.
+*/
+static void buildDict (FCODETREE *fcode_root, FCODEHASH *fcode_hash, unsigned int nitems, unsigned int *seq, size_t n, MEM_DICT *dict) {
+  FCODENODE *fcode_dict = NULL;
+  unsigned int *map = NULL;
+  unsigned int i = 0;
+  size_t total = 0;
+
+  fcode_dict = wmalloc (sizeof (FCODENODE) * nitems);
+  map = wmalloc (sizeof (unsigned int) * nitems);
+  map[0] = 0;
+  fcodeDictSort (fcode_root, fcode_hash, fcode_dict, map, false, nitems);
+  remapSequence (seq, n, map);
+
+  for (i = FIRST_FCODE; i < nitems; i++) {
+    total += fcode_dict[i].len;
+  }
+
+  dict -> nitems = nitems;
+  dict -> arena_len = total;
+  dict -> arena = wmalloc (sizeof (unsigned char) * (total + 1));
+  dict -> offset = wmalloc (sizeof (size_t) * nitems);
+  dict -> len = wmalloc (sizeof (unsigned int) * nitems);
+
+  dict -> offset[0] = 0;
+  dict -> len[0] = 0;
+  total = 0;
+  for (i = FIRST_FCODE; i < nitems; i++) {
+    dict -> offset[i] = total;
+    dict -> len[i] = fcode_dict[i].len;
+    memcpy (dict -> arena + total, fcode_dict[i].item, (size_t) fcode_dict[i].len);
+    total += fcode_dict[i].len;
+  }
+
+  wfree (map);
+  wfree (fcode_dict);
+
+  return;
+}
+
+
+/*  Copy the patterns of case of word_info, in the order of their
+**  ids, into dict  */
+static void copyCasePatterns (WORD_STRUCT *word_info, MEM_DICT *dict) {
+  FCODEENTRY *entry = NULL;
+  unsigned int i = 0;
+  size_t total = 0;
+
+  dict -> nitems = (word_info -> case_hash != NULL) ? word_info -> ncases : FIRST_FCODE;
+  for (i = FIRST_FCODE; i < dict -> nitems; i++) {
+    total += word_info -> case_hash -> entries[i].len;
+  }
+
+  dict -> arena_len = total;
+  dict -> arena = wmalloc (sizeof (unsigned char) * (total + 1));
+  dict -> offset = wmalloc (sizeof (size_t) * dict -> nitems);
+  dict -> len = wmalloc (sizeof (unsigned int) * dict -> nitems);
+
+  dict -> offset[0] = 0;
+  dict -> len[0] = 0;
+  total = 0;
+  for (i = FIRST_FCODE; i < dict -> nitems; i++) {
+    entry = &(word_info -> case_hash -> entries[i]);
+    dict -> offset[i] = total;
+    dict -> len[i] = entry -> len;
+    memcpy (dict -> arena + total, word_info -> case_hash -> pool + entry -> offset, (size_t) entry -> len);
+    total += entry -> len;
+  }
+
+  return;
+}
+
+
+/*
+**  Encode the len bytes of text without writing any files.  word_info
+**  and nonword_info must have been set up by initPrepair; their
+**  lexicons and statistics are updated as for fileEncode.  The
+**  sequences and dictionaries are returned in stream, which is freed
+**  with memStreamFree; the lexicons are freed with freeLexicons.
+*/
+void memEncode (const unsigned char *text, size_t len, WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info, MEM_STREAM *stream) {
+  PARSE_STRUCT parse;
+  unsigned int wrd_key = 0;
+  unsigned int nonwrd_key = 0;
+  unsigned int casefold_result = 0;
+  unsigned int stem_result = 0;
+
+  unsigned char *src_buff = NULL;
+  unsigned char *src_p = NULL;
+  unsigned char *src_end = NULL;
+  size_t text_pos = 0;
+  size_t num_read = 0;
+  size_t text_area = 0;
+
+  stream -> nsyms = 0;
+  stream -> size = MEM_INIT_SYMS;
+  stream -> ws = wmalloc (sizeof (unsigned int) * stream -> size);
+  stream -> cfm = wmalloc (sizeof (unsigned int) * stream -> size);
+  stream -> sm = wmalloc (sizeof (unsigned int) * stream -> size);
+  stream -> nws = wmalloc (sizeof (unsigned int) * stream -> size);
+
+  /*  The text is parsed from a buffer, as in fileEncode, so that the
+  **  parser can look past the end of it  */
+  initParse (&parse, word_info -> maxword);
+  src_buff = wmalloc (sizeof (unsigned char) * (INIT_BUFF_SIZE + MEM_LOOKAHEAD));
+
+  num_read = (len < INIT_BUFF_SIZE) ? len : INIT_BUFF_SIZE;
+  memcpy (src_buff, text, num_read);
+  memset (src_buff + num_read, 0, MEM_LOOKAHEAD);
+  text_pos = num_read;
+  src_p = src_buff;
+  src_end = src_buff + num_read;
+
+  do {
+    parseRecord (&src_p, src_end, word_info, nonword_info, &parse, &wrd_key, &casefold_result, &stem_result, &nonwrd_key);
+    appendRecord (stream, wrd_key, casefold_result, stem_result, nonwrd_key);
+
+    /*  Reload the buffer  */
+    text_area = (size_t) (src_end - src_p);
+    if ((text_area < MIN_BUFF_SIZE) && (text_pos < len)) {
+      memmove (src_buff, src_p, text_area);
+      num_read = INIT_BUFF_SIZE - text_area;
+      if (num_read > len - text_pos) {
+        num_read = len - text_pos;
+      }
+      memcpy (src_buff + text_area, text + text_pos, num_read);
+      text_pos += num_read;
+      src_p = src_buff;
+      src_end = src_buff + text_area + num_read;
+      memset (src_end, 0, MEM_LOOKAHEAD);
+    }
+  } while (src_p != src_end);
+
+  wfree (src_buff);
+  freeParse (&parse);
+
+  buildDict (word_info -> root_fc, word_info -> hash_fc, word_info -> nwords, stream -> ws, stream -> nsyms, &stream -> words);
+  buildDict (nonword_info -> root_fc, nonword_info -> hash_fc, nonword_info -> nnonwords, stream -> nws, stream -> nsyms, &stream -> nonwords);
+  copyCasePatterns (word_info, &stream -> cases);
+
+  return;
+}
+
+
+void memStreamFree (MEM_STREAM *stream) {
+  wfree (stream -> cases.len);
+  wfree (stream -> cases.offset);
+  wfree (stream -> cases.arena);
+  wfree (stream -> nonwords.len);
+  wfree (stream -> nonwords.offset);
+  wfree (stream -> nonwords.arena);
+  wfree (stream -> words.len);
+  wfree (stream -> words.offset);
+  wfree (stream -> words.arena);
+  wfree (stream -> nws);
+  wfree (stream -> sm);
+  wfree (stream -> cfm);
+  wfree (stream -> ws);
+
+  return;
+}
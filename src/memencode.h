@@ -0,0 +1,45 @@
+#ifndef MEMENCODE_H
+#define MEMENCODE_H
+
+/*  This header is installed with the library (libprepair), in
+**  include/prepair, together with the headers it needs.  A program
+**  which uses it includes <stdio.h> and <stdbool.h> and then
+**  wmalloc.h, prepair-defn.h, fcode.h, word.h, nonword.h, prepair.h
+**  and memencode.h, in that order, and links with -lprepair and the
+**  thread library.  */
+
+/*  Initial number of records allocated for each sequence  */
+#define MEM_INIT_SYMS 65536
+
+/*  A dictionary held in memory.  Entry i (in sorted order) is the
+**  len[i] bytes at arena + offset[i]; entry 0 is the zero-length
+**  entry.  */
+typedef struct memdict {
+  unsigned char *arena;
+  size_t arena_len;
+  size_t *offset;
+  unsigned int *len;
+  unsigned int nitems;                 /*  Including the 0-length entry  */
+} MEM_DICT;
+
+/*  The result of encoding text in memory:  the four sequences as
+**  arrays of nsyms values each (holding sorted ids, as in the .ws and
+**  .nws files), and the two dictionaries.  cases holds the patterns
+**  of case (as in the .cfx file), in the order of their ids.  */
+typedef struct memstream {
+  unsigned int *ws;
+  unsigned int *cfm;
+  unsigned int *sm;
+  unsigned int *nws;
+  size_t nsyms;
+  size_t size;                         /*  Space allocated in each array  */
+
+  MEM_DICT words;
+  MEM_DICT nonwords;
+  MEM_DICT cases;
+} MEM_STREAM;
+
+void memEncode (const unsigned char *text, size_t len, WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info, MEM_STREAM *stream);
+void memStreamFree (MEM_STREAM *stream);
+
+#endif
@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdbool.h>
+
+#include "common-def.h"
+#include "ustring.h"
+#include "wmalloc.h"
+#include "prepair-defn.h"
+#include "fcode.h"
+#include "word.h"
+#include "nonword.h"
+#include "prepair.h"
+#include "byteorder.h"
+#include "modseq.h"
+
+/*  Size of the hash table used to find the distinct values; at most
+**  half full  */
+#define MODSEQ_HASH_BITS 17
+#define MODSEQ_HASH_SIZE (1U << MODSEQ_HASH_BITS)
+
+
+/*
+**  Rewrite the plain modifier file name as a table of its distinct
+**  values and an index into it for each record.  The file is left as
+**  it is if it has too many distinct values or would not shrink.
+*/
+void modSeqCompact (unsigned char *name) {
+  MAP_STRUCT map;
+  const unsigned int *seq = NULL;
+  unsigned int *values = NULL;
+  unsigned int *slot_value = NULL;
+  unsigned int *slot_id = NULL;
+  unsigned char *out = NULL;
+  unsigned char *index = NULL;
+  unsigned int nvalues = 0;
+  unsigned int width = 0;
+  unsigned int h = 0;
+  size_t n = 0;
+  size_t i = 0;
+  size_t out_len = 0;
+  bool overflow = false;
+  FILE *fp = NULL;
+
+  mapFile (name, &map, ACCESS_SEQUENTIAL);
+  seq = (const unsigned int*) map.addr;
+  n = map.len / sizeof (unsigned int);
+  if (n == 0) {
+    unmapFile (&map);
+    return;
+  }
+
+  /*  Collect the distinct values, in order of appearance.  Slots hold
+  **  the id of a value plus one, so that 0 marks an empty slot.  */
+  values = wmalloc (sizeof (unsigned int) * MODSEQ_MAXVALUES);
+  slot_value = wmalloc (sizeof (unsigned int) * MODSEQ_HASH_SIZE);
+  slot_id = wmalloc (sizeof (unsigned int) * MODSEQ_HASH_SIZE);
+  memset (slot_id, 0, sizeof (unsigned int) * MODSEQ_HASH_SIZE);
+  for (i = 0; i < n; i++) {
+    h = (seq[i] * 2654435761U) >> (UINT_SIZE_BITS - MODSEQ_HASH_BITS);
+    while ((slot_id[h] != 0) && (slot_value[h] != seq[i])) {
+      h = (h + 1) & (MODSEQ_HASH_SIZE - 1);
+    }
+    if (slot_id[h] == 0) {
+      if (nvalues == MODSEQ_MAXVALUES) {
+        overflow = true;
+        break;
+      }
+      values[nvalues] = seq[i];
+      nvalues++;
+      slot_value[h] = seq[i];
+      slot_id[h] = nvalues;
+    }
+  }
+
+  width = (nvalues <= 256) ? 1 : 2;
+  out_len = MODSEQ_HEADER_SIZE + nvalues * sizeof (unsigned int) + n * width;
+  if ((overflow == true) || (out_len >= map.len)) {
+    wfree (slot_id);
+    wfree (slot_value);
+    wfree (values);
+    unmapFile (&map);
+    return;
+  }
+
+  out = wmalloc (out_len);
+  memset (out, 0, MODSEQ_HEADER_SIZE);
+  memcpy (out, MODSEQ_MAGIC, 3);
+  out[3] = (unsigned char) MODSEQ_VERSION;
+  out[4] = (unsigned char) width;
+  putLE (out + 8, (unsigned long long) nvalues, 4);
+  putLE (out + 16, (unsigned long long) n, 8);
+  for (i = 0; i < nvalues; i++) {
+    putLE (out + MODSEQ_HEADER_SIZE + i * sizeof (unsigned int), (unsigned long long) values[i], 4);
+  }
+
+  index = out + MODSEQ_HEADER_SIZE + nvalues * sizeof (unsigned int);
+  for (i = 0; i < n; i++) {
+    h = (seq[i] * 2654435761U) >> (UINT_SIZE_BITS - MODSEQ_HASH_BITS);
+    while (slot_value[h] != seq[i]) {
+      h = (h + 1) & (MODSEQ_HASH_SIZE - 1);
+    }
+    if (width == 1) {
+      index[i] = (unsigned char) (slot_id[h] - 1);
+    }
+    else {
+      putLE (index + 2 * i, (unsigned long long) (slot_id[h] - 1), 2);
+    }
+  }
+
+  wfree (slot_id);
+  wfree (slot_value);
+  wfree (values);
+  unmapFile (&map);
+
+  FOPEN (name, fp, "w");
+  (void) fwrite (out, sizeof (unsigned char), out_len, fp);
+  if ((ferror (fp) != 0) || (fclose (fp) != 0)) {
+    fprintf (stderr, "Error writing %s (%s, line %u).\n", name, __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+  wfree (out);
+
+  return;
+}
+
+
+/*
+**  Set up seq to read the modifier file held in map, which may be
+**  plain or compacted.  Returns the number of records.
+*/
+size_t modSeqInit (MOD_SEQ *seq, const MAP_STRUCT *map) {
+  const unsigned char *p = (const unsigned char*) map -> addr;
+  size_t n = 0;
+  size_t nvalues = 0;
+
+  seq -> raw = NULL;
+  seq -> values = NULL;
+  seq -> index = NULL;
+  seq -> width = 0;
+
+  if ((map -> len < MODSEQ_HEADER_SIZE) || (memcmp (p, MODSEQ_MAGIC, 3) != 0)) {
+    seq -> raw = (const unsigned int*) map -> addr;
+    return (map -> len / sizeof (unsigned int));
+  }
+
+  if (p[3] != (unsigned char) MODSEQ_VERSION) {
+    fprintf (stderr, "Unsupported modifier file version %u (%s, line %u).\n", (unsigned int) p[3], __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+  seq -> width = (unsigned int) p[4];
+  nvalues = (size_t) getLE (p + 8, 4);
+  n = (size_t) getLE (p + 16, 8);
+  if (((seq -> width != 1) && (seq -> width != 2)) || (nvalues > MODSEQ_MAXVALUES) ||
+      (map -> len != MODSEQ_HEADER_SIZE + nvalues * sizeof (unsigned int) + n * seq -> width)) {
+    fprintf (stderr, "Corrupt modifier file (%s, line %u).\n", __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+  seq -> values = p + MODSEQ_HEADER_SIZE;
+  seq -> index = p + MODSEQ_HEADER_SIZE + nvalues * sizeof (unsigned int);
+
+  return (n);
+}
+
+
+/*
+**  Rewrite the plain sequence file name with records of width bytes.
+**  The bits of a record outside mask are a flag, which is moved to
+**  the top bit of the wide record.  The records are written to a
+**  temporary file, which then replaces name.
+*/
+void symSeqWiden (unsigned char *name, unsigned int width, unsigned int mask) {
+  MAP_STRUCT map;
+  const unsigned int *seq = NULL;
+  unsigned char *buf = NULL;
+  unsigned char *p = NULL;
+  unsigned char *tmp_name = NULL;
+  unsigned long long top_bit = 1ULL << (width * 8 - 1);
+  unsigned long long value = 0;
+  size_t len = ustrlen (name);
+  size_t n = 0;
+  size_t i = 0;
+  FILE *fp = NULL;
+
+  mapFile (name, &map, ACCESS_SEQUENTIAL);
+  seq = (const unsigned int*) map.addr;
+  n = map.len / sizeof (unsigned int);
+
+  tmp_name = wmalloc (sizeof (unsigned char) * (len + 5));
+  memcpy (tmp_name, name, len);
+  memcpy (tmp_name + len, ".tmp", 5);
+  FOPEN (tmp_name, fp, "w");
+
+  buf = wmalloc (sizeof (unsigned char) * width * OUTBUFMAX);
+  memset (buf, 0, SYMSEQ_HEADER_SIZE);
+  memcpy (buf, SYMSEQ_MAGIC, 3);
+  buf[3] = (unsigned char) SYMSEQ_VERSION;
+  buf[4] = (unsigned char) width;
+  putLE (buf + 8, (unsigned long long) n, 8);
+  p = buf + SYMSEQ_HEADER_SIZE;
+
+  for (i = 0; i < n; i++) {
+    value = (unsigned long long) (seq[i] & mask);
+    if ((seq[i] & ~mask) != 0) {
+      value = value | top_bit;
+    }
+    putLE (p, value, width);
+    p += width;
+    if (p + width > buf + width * OUTBUFMAX) {
+      (void) fwrite (buf, sizeof (unsigned char), (size_t) (p - buf), fp);
+      p = buf;
+    }
+  }
+  if (p != buf) {
+    (void) fwrite (buf, sizeof (unsigned char), (size_t) (p - buf), fp);
+  }
+  if ((ferror (fp) != 0) || (fclose (fp) != 0)) {
+    fprintf (stderr, "Error writing %s (%s, line %u).\n", tmp_name, __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+  unmapFile (&map);
+
+  if (rename ((char*) tmp_name, (char*) name) != 0) {
+    fprintf (stderr, "Error renaming %s (%s, line %u).\n", tmp_name, __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+  wfree (buf);
+  wfree (tmp_name);
+
+  return;
+}
+
+
+/*
+**  Set up seq to read the sequence file held in map, which may be
+**  plain or wide.  The ids of a plain file are the bits under mask.
+**  Returns the number of records.
+*/
+size_t symSeqInit (SYM_SEQ *seq, const MAP_STRUCT *map, unsigned int mask) {
+  const unsigned char *p = (const unsigned char*) map -> addr;
+  unsigned int width = 0;
+  size_t n = 0;
+
+  seq -> raw = NULL;
+  seq -> mask = mask;
+  seq -> packed = NULL;
+  seq -> width = 0;
+
+  if ((map -> len >= SYMSEQ_HEADER_SIZE) && (memcmp (p, SYMSEQ_MAGIC, 3) == 0) &&
+      (p[3] == (unsigned char) SYMSEQ_VERSION) && (p[5] == 0) && (p[6] == 0) && (p[7] == 0)) {
+    width = (unsigned int) p[4];
+    n = (size_t) getLE (p + 8, 8);
+    if ((width != 5) || (n > (map -> len - SYMSEQ_HEADER_SIZE) / width) ||
+        (map -> len != SYMSEQ_HEADER_SIZE + n * width)) {
+      fprintf (stderr, "Corrupt sequence file (%s, line %u).\n", __FILE__, __LINE__);
+      exit (EXIT_FAILURE);
+    }
+    seq -> packed = p + SYMSEQ_HEADER_SIZE;
+    seq -> width = width;
+    return (n);
+  }
+
+  seq -> raw = (const unsigned int*) map -> addr;
+  return (map -> len / sizeof (unsigned int));
+}
+
+
+/*  The id of record i of a wide sequence; the flag in the top bit is
+**  dropped.  Lexicons hold at most UINT_MAX entries.  */
+unsigned int symSeqGet (const SYM_SEQ *seq, size_t i) {
+  unsigned long long value = getLE (seq -> packed + i * seq -> width, seq -> width);
+
+  value = value & ((1ULL << (seq -> width * 8 - 1)) - 1);
+  if (value > UINT_MAX) {
+    fprintf (stderr, "Corrupt sequence record %zu (%s, line %u).\n", i, __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+
+  return ((unsigned int) value);
+}
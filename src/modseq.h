@@ -0,0 +1,72 @@
+#ifndef MODSEQ_H
+#define MODSEQ_H
+
+/*  A modifier file (.cfm or .sm) is either a plain array of unsigned
+**  ints, one per record, or, when compacted, begins with a header of
+**  MODSEQ_HEADER_SIZE bytes:
+**    bytes 0-2:   the magic string MODSEQ_MAGIC
+**    byte 3:      the version of the format (MODSEQ_VERSION)
+**    byte 4:      the width of an index, in bytes (1 or 2)
+**    bytes 5-7:   reserved (0)
+**    bytes 8-11:  the number of distinct values (little-endian)
+**    bytes 12-15: reserved (0)
+**    bytes 16-23: the number of records (little-endian)
+**  The distinct values follow as little-endian unsigned ints of 4
+**  bytes, and then one little-endian index into them for each record.
+**  No modifier is large enough for a plain file to begin with the
+**  magic string.  */
+#define MODSEQ_MAGIC "PPM"
+#define MODSEQ_VERSION 1
+#define MODSEQ_HEADER_SIZE 24
+
+/*  Files with more distinct values are left as they are  */
+#define MODSEQ_MAXVALUES 65536
+
+/*  The little-endian values of 2 and 4 bytes at P  */
+#define MODSEQ_GET16(P) \
+  ((unsigned int) (P)[0] | ((unsigned int) (P)[1] << 8))
+#define MODSEQ_GET32(P) \
+  ((unsigned int) (P)[0] | ((unsigned int) (P)[1] << 8) | ((unsigned int) (P)[2] << 16) | ((unsigned int) (P)[3] << 24))
+
+/*  The modifier of record I of the sequence S  */
+#define GETMODIFIER(S,I) \
+  ((S) -> raw != NULL ? (S) -> raw[I] : \
+   ((S) -> width == 1 ? MODSEQ_GET32 ((S) -> values + 4 * (size_t) (S) -> index[I]) : \
+    MODSEQ_GET32 ((S) -> values + 4 * (size_t) MODSEQ_GET16 ((S) -> index + 2 * (size_t) (I)))))
+
+/*  A sequence file (.ws or .nws) is likewise either a plain array of
+**  unsigned ints or, when written with wide records, begins with a
+**  header of SYMSEQ_HEADER_SIZE bytes:
+**    bytes 0-2:   the magic string SYMSEQ_MAGIC
+**    byte 3:      the version of the format (SYMSEQ_VERSION)
+**    byte 4:      the width of a record, in bytes (5)
+**    bytes 5-7:   reserved (0)
+**    bytes 8-15:  the number of records (little-endian)
+**  The records follow, little-endian.  The top bit of a record is the
+**  end-of-phrase flag of FLAG_WORDS builds, and the bits below it
+**  hold the id.  A file which begins with the magic string, the
+**  version and the reserved bytes of a header is wide, and is corrupt
+**  if the rest of the header does not agree with its size.  (A plain
+**  file could only begin so with an id of over 22 million.)  */
+#define SYMSEQ_MAGIC "PPS"
+#define SYMSEQ_VERSION 1
+#define SYMSEQ_HEADER_SIZE 16
+
+/*  The bits of a plain word record which hold the id  */
+#ifdef FLAG_WORDS
+#define SYMSEQ_WORD_MASK NO_TOP_BIT
+#else
+#define SYMSEQ_WORD_MASK 0xFFFFFFFFU
+#endif
+
+/*  The id of record I of the sequence S, without any flag  */
+#define GETSYMBOL(S,I) \
+  ((S) -> raw != NULL ? ((S) -> raw[I] & (S) -> mask) : symSeqGet (S, I))
+
+void modSeqCompact (unsigned char *name);
+size_t modSeqInit (MOD_SEQ *seq, const MAP_STRUCT *map);
+void symSeqWiden (unsigned char *name, unsigned int width, unsigned int mask);
+size_t symSeqInit (SYM_SEQ *seq, const MAP_STRUCT *map, unsigned int mask);
+unsigned int symSeqGet (const SYM_SEQ *seq, size_t i);
+
+#endif
@@ -0,0 +1,632 @@
+/*
+   Multithreaded encoding.
+
+   The input is read in large blocks which are cut into chunks at
+   positions where a word follows a whitespace character.  The
+   single-threaded parser always starts a new (word, nonword) record
+   at such a position, so each chunk can be parsed, case-folded and
+   stemmed on its own thread, with its own lexicons, and still yield
+   exactly the records that fileEncode would have produced.  The ids
+   of each thread's lexicons are then merged into the global lexicons
+   in chunk order, which assigns global ids in the same first-seen
+   order as a single thread would.
+
+   With one thread, encoding is instead pipelined (fileEncodePipelined):
+   a reader thread reads blocks cut in the same way, the calling
+   thread parses them with the global lexicons, and a writer thread
+   writes out the records.  The blocks circulate between the three
+   through single-producer, single-consumer rings, so reading and
+   writing overlap with parsing.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "common-def.h"
+#include "wmalloc.h"
+#include "prepair-defn.h"
+#include "fcode.h"
+#include "word.h"
+#include "nonword.h"
+#include "prepair.h"
+#include "casefold.h"
+#include "mtencode.h"
+
+/*  Number of bytes read past the end of a chunk by getWord when it
+**  looks ahead at an apostrophe  */
+#define MT_LOOKAHEAD 4
+
+/*  A block of text and the records parsed from it.  Blocks go from the
+**  reader to the parser to the writer, and then back to the reader.  */
+typedef struct pipeblock {
+  unsigned char *text;
+  size_t len;                                    /*  Bytes to parse  */
+  size_t size;     /*  Bytes allocated, not counting MT_LOOKAHEAD  */
+  bool last;                              /*  Last block of the text  */
+  MTRECORDS records;
+} PIPEBLOCK;
+
+/*  A ring of blocks with one producer and one consumer.  Only
+**  PIPE_BLOCKS blocks exist, so a ring is never full and only the
+**  consumer waits.  It sleeps on ready only when the ring is empty,
+**  after setting waiting, which tells the producer to signal.  */
+typedef struct pipering {
+  PIPEBLOCK *slot[PIPE_BLOCKS];
+  atomic_size_t head;             /*  Blocks pushed, by the producer  */
+  size_t tail;                     /*  Blocks popped, by the consumer  */
+  atomic_bool waiting;
+  pthread_mutex_t lock;
+  pthread_cond_t ready;
+} PIPERING;
+
+/*  The state shared by the stages of the pipeline  */
+typedef struct pipeline {
+  FILE_STRUCT *file_info;
+  FILE *fp;
+  PIPERING filled;                         /*  Reader to parser  */
+  PIPERING parsed;                         /*  Parser to writer  */
+  PIPERING empty;                          /*  Writer to reader  */
+} PIPELINE;
+
+static void initRecords (MTRECORDS *records, unsigned int size);
+static void freeRecords (MTRECORDS *records);
+static void parseChunk (unsigned char *start, unsigned char *end, WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info, PARSE_STRUCT *parse, MTRECORDS *records);
+static void *encodeChunk (void *arg);
+static unsigned char *findBoundary (unsigned char *p, unsigned char *end);
+static size_t lastBoundary (unsigned char *buf, size_t len);
+static unsigned int splitChunks (MTWORKER *workers, unsigned int nthreads, unsigned char *buf, size_t len);
+static void mergeLexicon (FCODEHASH *local, unsigned int nlocal, unsigned int **map, unsigned int *merged, unsigned int *map_size, FCODEHASH *global, unsigned int *nglobal, unsigned long long *cmps, unsigned long long *total_len);
+static void writeChunk (FILE_STRUCT *file_info, MTWORKER *worker);
+static void initRing (PIPERING *ring);
+static void freeRing (PIPERING *ring);
+static void ringPush (PIPERING *ring, PIPEBLOCK *block);
+static PIPEBLOCK *ringPop (PIPERING *ring);
+static void *readBlocks (void *arg);
+static void *writeBlocks (void *arg);
+
+
+static void initRecords (MTRECORDS *records, unsigned int size) {
+  records -> size = size;
+  records -> ws = wmalloc (sizeof (unsigned int) * size);
+  records -> cfm = wmalloc (sizeof (unsigned int) * size);
+  records -> sm = wmalloc (sizeof (unsigned int) * size);
+  records -> nws = wmalloc (sizeof (unsigned int) * size);
+  records -> nrecords = 0;
+
+  return;
+}
+
+
+static void freeRecords (MTRECORDS *records) {
+  wfree (records -> nws);
+  wfree (records -> sm);
+  wfree (records -> cfm);
+  wfree (records -> ws);
+
+  return;
+}
+
+
+/*  Parse the text [start, end) into records.  As in fileEncode, at
+**  least one record is produced, even for empty text.  */
+static void parseChunk (unsigned char *start, unsigned char *end, WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info, PARSE_STRUCT *parse, MTRECORDS *records) {
+  unsigned char *src_p = start;
+  unsigned int n = 0;
+
+  parse -> notdone = false;
+  do {
+    if (n == records -> size) {
+      records -> size = records -> size << 1;
+      records -> ws = wrealloc (records -> ws, sizeof (unsigned int) * records -> size);
+      records -> cfm = wrealloc (records -> cfm, sizeof (unsigned int) * records -> size);
+      records -> sm = wrealloc (records -> sm, sizeof (unsigned int) * records -> size);
+      records -> nws = wrealloc (records -> nws, sizeof (unsigned int) * records -> size);
+    }
+    parseRecord (&src_p, end, word_info, nonword_info, parse, &records -> ws[n], &records -> cfm[n], &records -> sm[n], &records -> nws[n]);
+    n++;
+  } while (src_p != end);
+  records -> nrecords = n;
+
+  return;
+}
+
+
+/*  Thread body:  parse one chunk into records with local ids  */
+static void *encodeChunk (void *arg) {
+  MTWORKER *worker = (MTWORKER *) arg;
+
+  parseChunk (worker -> start, worker -> end, &worker -> word_info, &worker -> nonword_info, &worker -> parse, &worker -> records);
+
+  return (NULL);
+}
+
+
+/*  Return the first position in [p, end) at which a word follows a
+**  whitespace character, or NULL if there is none.  p must not be
+**  the start of the buffer.  */
+static unsigned char *findBoundary (unsigned char *p, unsigned char *end) {
+  for (; p < end; p++) {
+    if ((ISWORD (*p)) && (isspace ((int) *(p - 1)))) {
+      return (p);
+    }
+  }
+
+  return (NULL);
+}
+
+
+/*  Return the last position in buf at which a word follows a
+**  whitespace character, or 0 if there is none.  */
+static size_t lastBoundary (unsigned char *buf, size_t len) {
+  size_t i = 0;
+
+  for (i = len - 1; i > 0; i--) {
+    if ((ISWORD (buf[i])) && (isspace ((int) buf[i - 1]))) {
+      return (i);
+    }
+  }
+
+  return (0);
+}
+
+
+/*  Divide the first len bytes of buf into (at most) nthreads chunks
+**  of roughly equal size.  Returns the number of chunks.  */
+static unsigned int splitChunks (MTWORKER *workers, unsigned int nthreads, unsigned char *buf, size_t len) {
+  unsigned char *start = buf;
+  unsigned char *end = buf + len;
+  unsigned char *target = NULL;
+  unsigned char *q = NULL;
+  unsigned int nchunks = 0;
+  unsigned int i = 0;
+
+  for (i = 1; i < nthreads; i++) {
+    target = buf + (len / nthreads) * i;
+    if (target <= start) {
+      continue;
+    }
+    q = findBoundary (target, end);
+    if (q == NULL) {
+      break;
+    }
+    workers[nchunks].start = start;
+    workers[nchunks].end = q;
+    nchunks++;
+    start = q;
+  }
+  workers[nchunks].start = start;
+  workers[nchunks].end = end;
+  nchunks++;
+
+  return (nchunks);
+}
+
+
+/*  Give every id of the local lexicon that has not been seen before
+**  an id in the global lexicon.  */
+static void mergeLexicon (FCODEHASH *local, unsigned int nlocal, unsigned int **map, unsigned int *merged, unsigned int *map_size, FCODEHASH *global, unsigned int *nglobal, unsigned long long *cmps, unsigned long long *total_len) {
+  FCODEENTRY *entry = NULL;
+  unsigned int i = 0;
+
+  while (nlocal > *map_size) {
+    *map_size = (*map_size) << 1;
+    *map = wrealloc (*map, sizeof (unsigned int) * (*map_size));
+  }
+
+  for (i = *merged; i < nlocal; i++) {
+    entry = &(local -> entries[i]);
+    (*map)[i] = fcodeHashEncode (local -> pool + entry -> offset, entry -> len, global, nglobal, cmps, total_len);
+  }
+  *merged = nlocal;
+
+  return;
+}
+
+
+/*  Translate the records of a chunk into global ids and write them
+**  out.  */
+static void writeChunk (FILE_STRUCT *file_info, MTWORKER *worker) {
+  unsigned int wrd_key = 0;
+  unsigned int casefold_mod = 0;
+  unsigned int i = 0;
+
+  for (i = 0; i < worker -> records.nrecords; i++) {
+    wrd_key = worker -> records.ws[i];
+#ifdef FLAG_WORDS
+    if ((worker -> wrd_map[wrd_key & NO_TOP_BIT] & TOP_BIT) != 0) {
+      fprintf (stderr, "Too many distinct words for FLAG_WORDS (%s, line %u).\n", __FILE__, __LINE__);
+      exit (EXIT_FAILURE);
+    }
+    wrd_key = worker -> wrd_map[wrd_key & NO_TOP_BIT] | (wrd_key & TOP_BIT);
+#else
+    wrd_key = worker -> wrd_map[wrd_key];
+#endif
+    casefold_mod = worker -> records.cfm[i];
+    if (casefold_mod >= CASEFOLD_PATTERN) {
+      casefold_mod = CASEFOLD_PATTERN + worker -> case_map[casefold_mod - CASEFOLD_PATTERN];
+    }
+    writeFiles (file_info, wrd_key, casefold_mod, worker -> records.sm[i], worker -> nonwrd_map[worker -> records.nws[i]]);
+  }
+
+  return;
+}
+
+
+/*
+**  Process the file with nthreads threads.  The output is identical
+**  to that of fileEncode.  The global lexicons must be hash lexicons.
+*/
+void fileEncodeThreaded (FILE_STRUCT *file_info, FILE *fp, WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info, unsigned int nthreads) {
+  MTWORKER *workers = NULL;
+  MTWORKER *worker = NULL;
+  pthread_t *threads = NULL;
+  unsigned char *src_buff = NULL;
+  size_t buff_size = (size_t) nthreads * MT_CHUNK_SIZE;
+  size_t text_len = 0;
+  size_t nread = 0;
+  size_t limit = 0;
+  bool eof = false;
+  bool first = true;
+  unsigned int nchunks = 0;
+  unsigned int i = 0;
+  unsigned int j = 0;
+  unsigned long long case_cmps = 0;
+  unsigned long long case_len = 0;
+  FCODEENTRY *entries = NULL;
+
+  workers = wmalloc (sizeof (MTWORKER) * nthreads);
+  threads = wmalloc (sizeof (pthread_t) * nthreads);
+  for (i = 0; i < nthreads; i++) {
+    worker = &workers[i];
+    initPrepair (&worker -> word_info, &worker -> nonword_info, word_info -> maxword, word_info -> docasefold, word_info -> dostem, false, true);
+    initParse (&worker -> parse, word_info -> maxword);
+    worker -> word_info.sample_phases = word_info -> sample_phases;
+
+    worker -> wrd_map_size = INIT_FCODE_SIZE;
+    worker -> wrd_map = wmalloc (sizeof (unsigned int) * worker -> wrd_map_size);
+    worker -> wrd_map[EMPTY_FCODE] = EMPTY_FCODE;
+    worker -> wrd_merged = FIRST_FCODE;
+    worker -> nonwrd_map_size = INIT_FCODE_SIZE;
+    worker -> nonwrd_map = wmalloc (sizeof (unsigned int) * worker -> nonwrd_map_size);
+    worker -> nonwrd_map[EMPTY_FCODE] = EMPTY_FCODE;
+    worker -> nonwrd_merged = FIRST_FCODE;
+    worker -> case_map_size = INIT_FCODE_SIZE;
+    worker -> case_map = wmalloc (sizeof (unsigned int) * worker -> case_map_size);
+    worker -> case_map[EMPTY_FCODE] = EMPTY_FCODE;
+    worker -> case_merged = FIRST_FCODE;
+
+    initRecords (&worker -> records, MT_CHUNK_SIZE >> 2);
+  }
+
+  src_buff = wmalloc (sizeof (unsigned char) * (buff_size + MT_LOOKAHEAD));
+
+  while (eof == false) {
+    nread = fread (src_buff + text_len, sizeof (unsigned char), buff_size - text_len, fp);
+    text_len += nread;
+    file_info -> bytes_in += nread;
+    if (text_len < buff_size) {
+      eof = true;
+    }
+    /*  Make any look-ahead past the end of the text deterministic  */
+    memset (src_buff + text_len, 0, MT_LOOKAHEAD);
+
+    if (eof == true) {
+      limit = text_len;
+    }
+    else {
+      /*  Keep the last (partial) word for the next block; if the block
+      **  cannot be cut anywhere, then read more of it first  */
+      limit = lastBoundary (src_buff, text_len);
+      if (limit == 0) {
+        buff_size = buff_size << 1;
+        src_buff = wrealloc (src_buff, sizeof (unsigned char) * (buff_size + MT_LOOKAHEAD));
+        continue;
+      }
+    }
+    if ((limit == 0) && (first == false)) {
+      break;
+    }
+
+    nchunks = splitChunks (workers, nthreads, src_buff, limit);
+    for (i = 0; i < nchunks; i++) {
+      if (pthread_create (&threads[i], NULL, encodeChunk, &workers[i]) != 0) {
+        fprintf (stderr, "Error creating encoding thread (%s, line %u).\n", __FILE__, __LINE__);
+        exit (EXIT_FAILURE);
+      }
+    }
+    for (i = 0; i < nchunks; i++) {
+      (void) pthread_join (threads[i], NULL);
+    }
+
+    /*  Merge and write the chunks in order  */
+    for (i = 0; i < nchunks; i++) {
+      worker = &workers[i];
+      mergeLexicon (worker -> word_info.hash_fc, worker -> word_info.nwords, &worker -> wrd_map, &worker -> wrd_merged, &worker -> wrd_map_size, word_info -> hash_fc, &word_info -> nwords, &word_info -> cmps, &word_info -> total_words_len);
+      mergeLexicon (worker -> nonword_info.hash_fc, worker -> nonword_info.nnonwords, &worker -> nonwrd_map, &worker -> nonwrd_merged, &worker -> nonwrd_map_size, nonword_info -> hash_fc, &nonword_info -> nnonwords, &nonword_info -> cmps, &nonword_info -> total_nonwords_len);
+      if (word_info -> case_hash != NULL) {
+        mergeLexicon (worker -> word_info.case_hash, worker -> word_info.ncases, &worker -> case_map, &worker -> case_merged, &worker -> case_map_size, word_info -> case_hash, &word_info -> ncases, &case_cmps, &case_len);
+      }
+      writeChunk (file_info, worker);
+    }
+
+    memmove (src_buff, src_buff + limit, text_len - limit);
+    text_len -= limit;
+    first = false;
+  }
+
+  /*  The global frequencies are the sums of the local ones  */
+  entries = word_info -> hash_fc -> entries;
+  for (j = FIRST_FCODE; j < word_info -> nwords; j++) {
+    entries[j].freq = 0;
+  }
+  entries = nonword_info -> hash_fc -> entries;
+  for (j = FIRST_FCODE; j < nonword_info -> nnonwords; j++) {
+    entries[j].freq = 0;
+  }
+
+  for (i = 0; i < nthreads; i++) {
+    worker = &workers[i];
+
+    entries = word_info -> hash_fc -> entries;
+    for (j = FIRST_FCODE; j < worker -> wrd_merged; j++) {
+      entries[worker -> wrd_map[j]].freq += worker -> word_info.hash_fc -> entries[j].freq;
+    }
+    entries = nonword_info -> hash_fc -> entries;
+    for (j = FIRST_FCODE; j < worker -> nonwrd_merged; j++) {
+      entries[worker -> nonwrd_map[j]].freq += worker -> nonword_info.hash_fc -> entries[j].freq;
+    }
+
+    word_info -> cmps += worker -> word_info.cmps;
+    word_info -> total_tokens += worker -> word_info.total_tokens;
+    word_info -> total_length += worker -> word_info.total_length;
+    word_info -> long_tokens += worker -> word_info.long_tokens;
+    word_info -> enforce_tags += worker -> word_info.enforce_tags;
+    word_info -> zerolength_sym += worker -> word_info.zerolength_sym;
+    word_info -> cache_hits += worker -> word_info.cache_hits;
+    word_info -> cache_cmps += worker -> word_info.cache_cmps;
+    word_info -> sampled += worker -> word_info.sampled;
+    for (j = 0; j < NUM_PARSE_PHASES; j++) {
+      word_info -> sample_ns[j] += worker -> word_info.sample_ns[j];
+      word_info -> sample_marks[j] += worker -> word_info.sample_marks[j];
+    }
+
+    nonword_info -> cmps += worker -> nonword_info.cmps;
+    nonword_info -> total_tokens += worker -> nonword_info.total_tokens;
+    nonword_info -> total_length += worker -> nonword_info.total_length;
+    nonword_info -> long_tokens += worker -> nonword_info.long_tokens;
+    nonword_info -> enforce_tags += worker -> nonword_info.enforce_tags;
+    nonword_info -> zerolength_sym += worker -> nonword_info.zerolength_sym;
+
+    freeRecords (&worker -> records);
+    wfree (worker -> case_map);
+    wfree (worker -> nonwrd_map);
+    wfree (worker -> wrd_map);
+    freeParse (&worker -> parse);
+    freeLexicons (&worker -> word_info, &worker -> nonword_info);
+  }
+
+  wfree (src_buff);
+  wfree (threads);
+  wfree (workers);
+
+  return;
+}
+
+
+static void initRing (PIPERING *ring) {
+  atomic_init (&ring -> head, 0);
+  ring -> tail = 0;
+  atomic_init (&ring -> waiting, false);
+  if ((pthread_mutex_init (&ring -> lock, NULL) != 0) || (pthread_cond_init (&ring -> ready, NULL) != 0)) {
+    fprintf (stderr, "Error creating the encoding pipeline (%s, line %u).\n", __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+
+  return;
+}
+
+
+static void freeRing (PIPERING *ring) {
+  (void) pthread_cond_destroy (&ring -> ready);
+  (void) pthread_mutex_destroy (&ring -> lock);
+
+  return;
+}
+
+
+/*  Add block to the ring; the lock is only taken if the consumer is
+**  (about to be) asleep.  The stores and loads of head and waiting are
+**  sequentially consistent, so either the consumer sees the new head
+**  or this sees that it is waiting.  */
+static void ringPush (PIPERING *ring, PIPEBLOCK *block) {
+  size_t head = atomic_load_explicit (&ring -> head, memory_order_relaxed);
+
+  ring -> slot[head % PIPE_BLOCKS] = block;
+  atomic_store (&ring -> head, head + 1);
+  if (atomic_load (&ring -> waiting) == true) {
+    pthread_mutex_lock (&ring -> lock);
+    pthread_cond_signal (&ring -> ready);
+    pthread_mutex_unlock (&ring -> lock);
+  }
+
+  return;
+}
+
+
+/*  Take the next block from the ring, waiting for one if need be  */
+static PIPEBLOCK *ringPop (PIPERING *ring) {
+  PIPEBLOCK *block = NULL;
+
+  if (atomic_load_explicit (&ring -> head, memory_order_acquire) == ring -> tail) {
+    pthread_mutex_lock (&ring -> lock);
+    atomic_store (&ring -> waiting, true);
+    while (atomic_load (&ring -> head) == ring -> tail) {
+      pthread_cond_wait (&ring -> ready, &ring -> lock);
+    }
+    atomic_store (&ring -> waiting, false);
+    pthread_mutex_unlock (&ring -> lock);
+  }
+  block = ring -> slot[ring -> tail % PIPE_BLOCKS];
+  ring -> tail++;
+
+  return (block);
+}
+
+
+/*  Reader thread:  fill empty blocks with text, cut where a word
+**  follows a whitespace character as for fileEncodeThreaded.  The
+**  text after the cut is carried over to the next block.  */
+static void *readBlocks (void *arg) {
+  PIPELINE *pipe = (PIPELINE *) arg;
+  PIPEBLOCK *block = NULL;
+  unsigned char *carry = NULL;
+  size_t carry_len = 0;
+  size_t carry_size = PIPE_BLOCK_SIZE;
+  size_t text_len = 0;
+  size_t nread = 0;
+  size_t limit = 0;
+  bool eof = false;
+
+  carry = wmalloc (sizeof (unsigned char) * carry_size);
+  while (eof == false) {
+    block = ringPop (&pipe -> empty);
+    while (block -> size <= carry_len) {
+      block -> size = block -> size << 1;
+      block -> text = wrealloc (block -> text, sizeof (unsigned char) * (block -> size + MT_LOOKAHEAD));
+    }
+    memcpy (block -> text, carry, carry_len);
+    text_len = carry_len;
+
+    while (true) {
+      nread = fread (block -> text + text_len, sizeof (unsigned char), block -> size - text_len, pipe -> fp);
+      text_len += nread;
+      pipe -> file_info -> bytes_in += nread;
+      /*  Make any look-ahead past the end of the text deterministic  */
+      memset (block -> text + text_len, 0, MT_LOOKAHEAD);
+      if (text_len < block -> size) {
+        eof = true;
+        limit = text_len;
+        break;
+      }
+      /*  If the block cannot be cut anywhere, read more of it first  */
+      limit = lastBoundary (block -> text, text_len);
+      if (limit != 0) {
+        break;
+      }
+      block -> size = block -> size << 1;
+      block -> text = wrealloc (block -> text, sizeof (unsigned char) * (block -> size + MT_LOOKAHEAD));
+    }
+
+    carry_len = text_len - limit;
+    if (carry_len > carry_size) {
+      carry_size = carry_len;
+      carry = wrealloc (carry, sizeof (unsigned char) * carry_size);
+    }
+    memcpy (carry, block -> text + limit, carry_len);
+
+    block -> len = limit;
+    block -> last = eof;
+    ringPush (&pipe -> filled, block);
+  }
+  wfree (carry);
+
+  return (NULL);
+}
+
+
+/*  Writer thread:  write the records of each parsed block and give
+**  the block back to the reader  */
+static void *writeBlocks (void *arg) {
+  PIPELINE *pipe = (PIPELINE *) arg;
+  PIPEBLOCK *block = NULL;
+  MTRECORDS *records = NULL;
+  unsigned int i = 0;
+  bool last = false;
+
+  while (last == false) {
+    block = ringPop (&pipe -> parsed);
+    records = &block -> records;
+    for (i = 0; i < records -> nrecords; i++) {
+      writeFiles (pipe -> file_info, records -> ws[i], records -> cfm[i], records -> sm[i], records -> nws[i]);
+    }
+    last = block -> last;
+    ringPush (&pipe -> empty, block);
+  }
+
+  return (NULL);
+}
+
+
+/*
+**  Process the file as fileEncode does, with the reading and writing
+**  done by two more threads.  The text is parsed on this thread, with
+**  the global lexicons (of either kind), so the output is identical.
+**  The files of file_info must not be written to until this returns.
+*/
+void fileEncodePipelined (FILE_STRUCT *file_info, FILE *fp, WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info) {
+  PIPELINE pipe;
+  PIPEBLOCK *blocks = NULL;
+  PIPEBLOCK *block = NULL;
+  PARSE_STRUCT parse;
+  pthread_t reader;
+  pthread_t writer;
+  bool first = true;
+  bool last = false;
+  unsigned int i = 0;
+
+  pipe.file_info = file_info;
+  pipe.fp = fp;
+  initRing (&pipe.filled);
+  initRing (&pipe.parsed);
+  initRing (&pipe.empty);
+
+  blocks = wmalloc (sizeof (PIPEBLOCK) * PIPE_BLOCKS);
+  for (i = 0; i < PIPE_BLOCKS; i++) {
+    blocks[i].size = PIPE_BLOCK_SIZE;
+    blocks[i].text = wmalloc (sizeof (unsigned char) * (PIPE_BLOCK_SIZE + MT_LOOKAHEAD));
+    blocks[i].len = 0;
+    blocks[i].last = false;
+    initRecords (&blocks[i].records, PIPE_BLOCK_SIZE >> 3);
+    ringPush (&pipe.empty, &blocks[i]);
+  }
+  initParse (&parse, word_info -> maxword);
+
+  if ((pthread_create (&reader, NULL, readBlocks, &pipe) != 0) || (pthread_create (&writer, NULL, writeBlocks, &pipe) != 0)) {
+    fprintf (stderr, "Error creating encoding thread (%s, line %u).\n", __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+
+  /*  As for fileEncodeThreaded, empty text still gives one record, but
+  **  an empty last block (after a cut at the end of the text) gives
+  **  none  */
+  while (last == false) {
+    block = ringPop (&pipe.filled);
+    block -> records.nrecords = 0;
+    if ((block -> len != 0) || (first == true)) {
+      parseChunk (block -> text, block -> text + block -> len, word_info, nonword_info, &parse, &block -> records);
+    }
+    first = false;
+    last = block -> last;
+    ringPush (&pipe.parsed, block);
+  }
+
+  (void) pthread_join (reader, NULL);
+  (void) pthread_join (writer, NULL);
+
+  freeParse (&parse);
+  for (i = 0; i < PIPE_BLOCKS; i++) {
+    freeRecords (&blocks[i].records);
+    wfree (blocks[i].text);
+  }
+  wfree (blocks);
+  freeRing (&pipe.empty);
+  freeRing (&pipe.parsed);
+  freeRing (&pipe.filled);
+
+  return;
+}
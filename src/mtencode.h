@@ -0,0 +1,58 @@
+#ifndef MTENCODE_H
+#define MTENCODE_H
+
+/*  Maximum number of encoding threads  */
+#define MAX_THREADS 256
+
+/*  Amount of text given to each thread at a time.  Chunks are only
+**  cut where a word follows a whitespace character, so they may be
+**  somewhat shorter.  */
+#define MT_CHUNK_SIZE 4194304
+
+/*  Size of a block of text read at a time by the pipelined encoder,
+**  and the number of blocks in flight between its stages  */
+#define PIPE_BLOCK_SIZE 4194304
+#define PIPE_BLOCKS 4
+
+/*  Records parsed from a chunk of text, one value of each per record  */
+typedef struct mtrecords {
+  unsigned int *ws;
+  unsigned int *cfm;
+  unsigned int *sm;
+  unsigned int *nws;
+  unsigned int nrecords;
+  unsigned int size;                   /*  Number of records allocated  */
+} MTRECORDS;
+
+/*  Work done by one encoding thread.  The lexicons in word_info and
+**  nonword_info belong to the thread and are kept across chunks;
+**  wrd_map and nonwrd_map translate their ids into the global id
+**  space and cover the first wrd_merged / nonwrd_merged ids, as
+**  case_map does for the patterns of case (with -c).  */
+typedef struct mtworker {
+  WORD_STRUCT word_info;
+  NONWORD_STRUCT nonword_info;
+  PARSE_STRUCT parse;
+
+  unsigned int *wrd_map;
+  unsigned int wrd_merged;
+  unsigned int wrd_map_size;
+  unsigned int *nonwrd_map;
+  unsigned int nonwrd_merged;
+  unsigned int nonwrd_map_size;
+  unsigned int *case_map;
+  unsigned int case_merged;
+  unsigned int case_map_size;
+
+  /*  The chunk of text  */
+  unsigned char *start;
+  unsigned char *end;
+
+  /*  Records produced from the chunk, with local ids  */
+  MTRECORDS records;
+} MTWORKER;
+
+void fileEncodeThreaded (FILE_STRUCT *file_info, FILE *fp, WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info, unsigned int nthreads);
+void fileEncodePipelined (FILE_STRUCT *file_info, FILE *fp, WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info);
+
+#endif
@@ -7,13 +7,16 @@
 #include <stdbool.h>
 
 #include "common-def.h"
+#include "wmalloc.h"
 #include "prepair-defn.h"
 #include "fcode.h"
 #include "nonword.h"
+#include "tokscan.h"
 
-unsigned int getNonWord (unsigned char **src_p, unsigned char *src_end, unsigned char *w, unsigned int lim, bool *notdone, unsigned int *long_tokens) {
+unsigned int getNonWord (unsigned char **src_p, unsigned char *src_end, unsigned char *w, unsigned int lim, bool *notdone, unsigned long long *long_tokens) {
   unsigned int len = 0;
   unsigned int c = 0;
+  size_t run = 0;
 
   *notdone = false;
   do {
@@ -21,6 +24,20 @@ unsigned int getNonWord (unsigned char **src_p, unsigned char *src_end, unsigned
       *notdone = true;
       break;
     }
+
+    /*  Copy a run of nonword characters at once  */
+    run = scanNonWordRun (*src_p, src_end, (size_t) (lim - len));
+    if (run != 0) {
+      memcpy (w, *src_p, run);
+      w += run;
+      *src_p += run;
+      len += (unsigned int) run;
+      if (*src_p == src_end) {
+        *notdone = true;
+        break;
+      }
+    }
+
     c = (unsigned int) **src_p;
     if (ISWORD (c)) {
       break;
@@ -6,26 +6,29 @@ typedef struct nonwordstruct {
   unsigned int maxnonword;                /*  Maximum length of a nonword  */
 
   unsigned int nnonwords;                          /*  Number of nonwords  */
-  unsigned int total_nonwords_len;     /*  Length of all words in lexicon  */
+  unsigned long long total_nonwords_len; /*  Length of all words in lexicon  */
   unsigned int nnonwords_prims;  /*  Number of words which are in Latin-1  */
-  unsigned int cmps;               /*  Number of splay tree nodes visited  */
+  unsigned long long cmps;         /*  Number of splay tree nodes visited  */
   unsigned int *map;           /*  Map used to re-encode sequence symbols  */
  
   /*  Statistics about parsing  */
-  unsigned int total_tokens;
-  unsigned int total_length;
-  unsigned int long_tokens;
-  unsigned int enforce_tags;
-  unsigned int zerolength_sym;
+  unsigned long long total_tokens;
+  unsigned long long total_length;
+  unsigned long long long_tokens;
+  unsigned long long enforce_tags;
+  unsigned long long zerolength_sym;
 
   /*  Front-coding words  */
   FCODETREE *root_fc;
+  FCODEHASH *hash_fc;          /*  Hash lexicon, used instead of root_fc  */
   FCODENODE *dict_fc;
+  FCODEDICT *pool_fc;             /*  Dictionary loaded for decoding  */
+  WMARENA *arena_fc;                /*  Nodes and items of root_fc  */
   bool printsorted;         /*  Print nonwords in sorted order  */
 } NONWORD_STRUCT;
 
 
-unsigned int getNonWord (unsigned char **src_p, unsigned char *src_end, unsigned char *w, unsigned int lim, bool *notdone, unsigned int *long_tokens);
+unsigned int getNonWord (unsigned char **src_p, unsigned char *src_end, unsigned char *w, unsigned int lim, bool *notdone, unsigned long long *long_tokens);
 
 #endif
 
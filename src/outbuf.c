@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "common-def.h"
+#include "wmalloc.h"
+#include "outbuf.h"
+
+
+/*  Prepare a buffer for output to fp.  Anything already written to fp
+**  through stdio is flushed first, since the buffer bypasses it.  */
+void initOutBuf (OUT_BUF *ob, FILE *fp) {
+  (void) fflush (fp);
+  ob -> fd = fileno (fp);
+  ob -> buf = wmalloc (sizeof (unsigned char) * OUTBUF_SIZE);
+  ob -> p = ob -> buf;
+  ob -> end = ob -> buf + OUTBUF_SIZE;
+  ob -> written = 0;
+
+  return;
+}
+
+
+/*  Prepare a buffer which gathers output in memory only  */
+void initOutBufMem (OUT_BUF *ob) {
+  ob -> fd = -1;
+  ob -> buf = wmalloc (sizeof (unsigned char) * OUTBUF_SIZE);
+  ob -> p = ob -> buf;
+  ob -> end = ob -> buf + OUTBUF_SIZE;
+  ob -> written = 0;
+
+  return;
+}
+
+
+/*  Write the len bytes at q to fd  */
+static void writeBytes (int fd, const unsigned char *q, size_t len) {
+  const unsigned char *end = q + len;
+  ssize_t nbytes = 0;
+
+  while (q < end) {
+    nbytes = write (fd, q, (size_t) (end - q));
+    if (nbytes < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      fprintf (stderr, "Error writing decoded output (%s, line %u).\n", __FILE__, __LINE__);
+      exit (EXIT_FAILURE);
+    }
+    q += nbytes;
+  }
+
+  return;
+}
+
+
+/*  Write out the contents of the buffer and empty it.  A buffer in
+**  memory is instead doubled in size, so that OUTBUF_SIZE more bytes
+**  fit.  */
+void flushOutBuf (OUT_BUF *ob) {
+  size_t used = (size_t) (ob -> p - ob -> buf);
+  size_t size = (size_t) (ob -> end - ob -> buf);
+
+  if (ob -> fd < 0) {
+    while (size - used < OUTBUF_SIZE) {
+      size = size << 1;
+    }
+    ob -> buf = wrealloc (ob -> buf, sizeof (unsigned char) * size);
+    ob -> p = ob -> buf + used;
+    ob -> end = ob -> buf + size;
+    return;
+  }
+
+  writeBytes (ob -> fd, ob -> buf, used);
+  ob -> written += (unsigned long long) used;
+  ob -> p = ob -> buf;
+
+  return;
+}
+
+
+/*  Write out the contents of the buffer src, which is in memory, to
+**  the file of dst, after anything already in dst.  src is emptied
+**  but keeps its memory.  */
+void copyOutBuf (OUT_BUF *dst, OUT_BUF *src) {
+  size_t len = (size_t) (src -> p - src -> buf);
+
+  flushOutBuf (dst);
+  writeBytes (dst -> fd, src -> buf, len);
+  dst -> written += (unsigned long long) len;
+  src -> p = src -> buf;
+
+  return;
+}
+
+
+void freeOutBuf (OUT_BUF *ob) {
+  if (ob -> fd >= 0) {
+    flushOutBuf (ob);
+  }
+  wfree (ob -> buf);
+  ob -> buf = NULL;
+  ob -> p = NULL;
+  ob -> end = NULL;
+
+  return;
+}
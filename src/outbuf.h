@@ -0,0 +1,47 @@
+#ifndef OUTBUF_H
+#define OUTBUF_H
+
+/*  Size of the buffer used for decoded output  */
+#define OUTBUF_SIZE 4194304
+
+/*  Output is gathered in a large buffer and handed to the operating
+**  system with write () when the buffer is full, so that no stdio
+**  locking or per-character call is made while decoding.  A buffer
+**  made with initOutBufMem has no file (fd is -1); it grows instead,
+**  and its contents are written out later with copyOutBuf.  */
+typedef struct outbufstruct {
+  int fd;
+  unsigned char *buf;
+  unsigned char *p;
+  unsigned char *end;
+  unsigned long long written;          /*  Bytes handed to write () so far  */
+} OUT_BUF;
+
+/*  Append LEN bytes of DATA to the buffer OB.  LEN must not be larger
+**  than OUTBUF_SIZE.  */
+#define OUTBUFWRITE(OB,DATA,LEN) \
+  do { \
+    if ((size_t) ((OB) -> end - (OB) -> p) < (size_t) (LEN)) { \
+      flushOutBuf (OB); \
+    } \
+    memcpy ((OB) -> p, DATA, (size_t) (LEN)); \
+    (OB) -> p += (LEN); \
+  } while (0)
+
+/*  Append the single character C to the buffer OB.  */
+#define OUTBUFPUTC(OB,C) \
+  do { \
+    if ((OB) -> p == (OB) -> end) { \
+      flushOutBuf (OB); \
+    } \
+    *((OB) -> p) = (unsigned char) (C); \
+    ((OB) -> p)++; \
+  } while (0)
+
+void initOutBuf (OUT_BUF *ob, FILE *fp);
+void initOutBufMem (OUT_BUF *ob);
+void flushOutBuf (OUT_BUF *ob);
+void copyOutBuf (OUT_BUF *dst, OUT_BUF *src);
+void freeOutBuf (OUT_BUF *ob);
+
+#endif
@@ -11,19 +11,59 @@
 **  line. The length, maxword, must satisfy:  
 **  WORDLEN <= maxword <= MAXWORDLEN  */
 #define WORDLEN 12
-#define MAXWORDLEN 16
+#define MAXWORDLEN 255
 
 /*  The header for a word in the word dictionary contains a
-**  one byte match/length header (4 bits each) and, for appended
-**  words, an additional 4 bytes to reference the longest match
-**  in the dictionary.  */
+**  one byte prefix/suffix length header (4 bits each) and, for
+**  lengths which do not fit in 4 bits, up to 2 bytes for each of
+**  the two lengths as varints.  */
 #define MAXWORDLEN_HEADER  5
 
-#define ISWORD(C)  ((isalnum ((int) C)) || ((unsigned int) C == (unsigned int) '<') || ((unsigned int) C == (unsigned int) '>') || ((unsigned int) C == (unsigned int) '/'))
+/*  A word character is alphanumeric or one of '<', '>' and '/'; the
+**  classes of all bytes are in tok_class (tokscan.c)  */
+extern const unsigned char tok_class[256];
+#define ISWORD(C)  (tok_class[(unsigned char) (C)] != 0)
 enum WORDTYPE { ISWORD = 0, ISNONWORD = 1 };
 
 enum PROGMODE { MODE_NONE = 0, MODE_ENCODE = 1, MODE_DECODE = 2, MODE_DECODE_NONE = 3, MODE_DECODE_LINK = 4 };
 
+/*  Phases of parsing a record which are timed, when requested, on one
+**  record in every PHASE_SAMPLE_RATE (see parseRecord)  */
+enum PARSEPHASE { PHASE_TOKENIZE = 0, PHASE_NORMALIZE = 1, PHASE_LEXICON = 2, NUM_PARSE_PHASES = 3 };
+#define PHASE_SAMPLE_RATE 64
+
+/*  How a mapped file is going to be read, which is passed on to the
+**  kernel (see mapFile)  */
+enum MAPACCESS { ACCESS_NORMAL = 0, ACCESS_SEQUENTIAL = 1, ACCESS_RANDOM = 2 };
+
+/*  A whole file mapped into (or, failing that, read into) memory  */
+typedef struct mapstruct {
+  void *addr;
+  size_t len;
+  bool mapped;                   /*  false if read into allocated memory  */
+  bool section;                  /*  part of a container (see container.h)  */
+} MAP_STRUCT;
+
+/*  A modifier sequence, read either from a plain array (raw) or from
+**  a table of distinct values and an index of width bytes per record,
+**  both little-endian (see modseq.h)  */
+typedef struct modseq {
+  const unsigned int *raw;
+  const unsigned char *values;
+  const unsigned char *index;
+  unsigned int width;
+} MOD_SEQ;
+
+/*  A word or nonword sequence, read either from a plain array (raw,
+**  whose ids are under mask) or from records of width bytes each
+**  (see modseq.h)  */
+typedef struct symseq {
+  const unsigned int *raw;
+  unsigned int mask;
+  const unsigned char *packed;
+  unsigned int width;
+} SYM_SEQ;
+
 typedef struct filestruct {
   /*  Word dictionary, extension ".wd"  */
   unsigned char *wd_name;
@@ -60,6 +100,10 @@ typedef struct filestruct {
   unsigned int *cfm_p;
   unsigned int *cfm_end;
 
+  /*  Patterns of case of words beyond the case-folding mask (see
+  **  casefold.h), extension ".cfx", written only if there are any  */
+  unsigned char *cfx_name;
+
   /*  Stemming modifiers, extension ".sm"  */
   unsigned char *sm_name;
   FILE *sm_fp;
@@ -67,7 +111,44 @@ typedef struct filestruct {
   unsigned int *sm_p;
   unsigned int *sm_end;
 
+  /*  Surface forms (optional, see surface.h):  the distinct words as
+  **  written, extension ".srf", and the surface form of each record,
+  **  extension ".ss"  */
+  unsigned char *srf_name;
+  unsigned char *ss_name;
+
+  /*  When decoding, the four sequences are mapped into memory and are
+  **  used as arrays of nsyms symbols each  */
+  MAP_STRUCT ws_map;
+  MAP_STRUCT nws_map;
+  MAP_STRUCT cfm_map;
+  MAP_STRUCT sm_map;
+  SYM_SEQ ws_sym;
+  SYM_SEQ nws_sym;
+  MOD_SEQ cfm_mod;
+  MOD_SEQ sm_mod;
+  size_t nsyms;
+
+  /*  And so is ".ss", if it exists  */
+  MAP_STRUCT ss_map;
+  SYM_SEQ ss_sym;
+  bool has_surface;
+
+  /*  The container of all of the above (optional, see container.h),
+  **  extension ".ppc".  When decoding, it is mapped if it exists and
+  **  every file is read from it instead.  */
+  unsigned char *ppc_name;
+  MAP_STRUCT container_map;
+  bool in_container;
+
   bool verbose_level;
+  bool compact_mods;             /*  compact .cfm and .sm when closing  */
+  bool flat_dicts;               /*  write .wd and .nwd in the flat format  */
+  bool surface_forms;            /*  write .srf and .ss after closing  */
+  bool pack_container;           /*  pack the files into .ppc after closing  */
+  unsigned int seq_width;        /*  bytes in a record of .ws and .nws  */
+  unsigned long long bytes_in;   /*  bytes of text read when encoding  */
+  unsigned long long bytes_out;  /*  bytes of text written when decoding  */
   enum PROGMODE mode;
 } FILE_STRUCT;
 
@@ -28,6 +28,12 @@
 #include <ctype.h>
 #include <limits.h>
 #include <stdbool.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <pthread.h>
 
 #include "common-def.h"
 #include "wmalloc.h"
@@ -39,9 +45,16 @@
 #include "word.h"
 #include "nonword.h"
 #include "prepair.h"
+#include "outbuf.h"
+#include "modseq.h"
+#include "stats.h"
+#include "surface.h"
+#include "container.h"
 
 /*  Initialise word and nonword data structures  */
-void initPrepair (WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info, unsigned int maxword, bool docasefold, bool dostem, bool printsorted) {
+void initPrepair (WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info, unsigned int maxword, bool docasefold, bool dostem, bool printsorted, bool usehash) {
+  unsigned int i = 0;
+
   /*  Word data structure  */
   word_info -> maxword = maxword;
   word_info -> docasefold = docasefold;
@@ -58,11 +71,44 @@ void initPrepair (WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info, unsigned
   word_info -> long_tokens = 0;
   word_info -> enforce_tags = 0;
   word_info -> zerolength_sym = 0;
+  word_info -> cache_hits = 0;
+  word_info -> cache_cmps = 0;
+
+  word_info -> sample_phases = false;
+  word_info -> sample_countdown = PHASE_SAMPLE_RATE;
+  word_info -> sampled = 0;
+  for (i = 0; i < NUM_PARSE_PHASES; i++) {
+    word_info -> sample_ns[i] = 0;
+    word_info -> sample_marks[i] = 0;
+  }
 
   word_info -> root_fc = NULL;
+  word_info -> hash_fc = NULL;
+  if (usehash == true) {
+    word_info -> hash_fc = fcodeHashInit ();
+  }
   word_info -> dict_fc = NULL;
+  word_info -> pool_fc = NULL;
+  word_info -> surface_fc = NULL;
+  word_info -> arena_fc = wmArenaInit (WM_ARENA_BLOCK);
   word_info -> printsorted = printsorted;
 
+  word_info -> stem_cache = NULL;
+  if ((usehash == true) && ((docasefold == true) || (dostem == true))) {
+    word_info -> stem_cache = wmalloc (sizeof (STEMCACHE));
+    word_info -> stem_cache -> surface = fcodeHashInit ();
+    word_info -> stem_cache -> nsurface = FIRST_FCODE;
+    word_info -> stem_cache -> size = INIT_STEMCACHE_SIZE;
+    word_info -> stem_cache -> entries = wmalloc (sizeof (STEMCACHEENTRY) * INIT_STEMCACHE_SIZE);
+  }
+
+  word_info -> case_hash = NULL;
+  if (docasefold == true) {
+    word_info -> case_hash = fcodeHashInit ();
+  }
+  word_info -> ncases = FIRST_FCODE;
+  word_info -> case_fc = NULL;
+
   word_info -> nwords = FIRST_FCODE;
 
   /*  Nonword data structure  */
@@ -81,7 +127,13 @@ void initPrepair (WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info, unsigned
   nonword_info -> zerolength_sym = 0;
 
   nonword_info -> root_fc = NULL;
+  nonword_info -> hash_fc = NULL;
+  if (usehash == true) {
+    nonword_info -> hash_fc = fcodeHashInit ();
+  }
   nonword_info -> dict_fc = NULL;
+  nonword_info -> pool_fc = NULL;
+  nonword_info -> arena_fc = wmArenaInit (WM_ARENA_BLOCK);
   nonword_info -> printsorted = printsorted;
 
   nonword_info -> nnonwords = FIRST_FCODE;
@@ -121,119 +173,297 @@ void writeFiles (FILE_STRUCT *file_info, unsigned int wrd_key, unsigned int case
 }
 
 
-unsigned int readFiles (FILE_STRUCT *file_info, unsigned int *wrd_key, unsigned int *casefold_result, unsigned int *stem_result, unsigned int *nonwrd_key) {
-  unsigned int intsread = 0;
+/*  Tell the kernel how map (a whole file or a section of a mapped
+**  container) is going to be read.  Nothing is done for a file which
+**  was read into memory.  */
+void adviseMap (MAP_STRUCT *map, enum MAPACCESS access) {
+  static const int advice[3] = { MADV_NORMAL, MADV_SEQUENTIAL, MADV_RANDOM };
+  size_t page = (size_t) sysconf (_SC_PAGESIZE);
+  size_t skip = 0;
 
-  if (file_info -> ws_p == file_info -> ws_end) {
-    if (feof (file_info -> ws_fp)) {
-      return (0);
+  if ((map -> mapped == false) || (map -> addr == NULL) || (map -> len == 0)) {
+    return;
+  }
+  /*  A section need not begin on a page  */
+  skip = (size_t) ((unsigned long) map -> addr % page);
+  (void) madvise ((unsigned char*) map -> addr - skip, map -> len + skip, advice[access]);
+
+  return;
+}
+
+
+/*  Map the file name into memory, or read it into memory if it cannot
+**  be mapped.  The kernel is told to expect the given access.  */
+void mapFile (unsigned char *name, MAP_STRUCT *map, enum MAPACCESS access) {
+  int fd = -1;
+  struct stat st;
+  ssize_t nbytes = 0;
+  size_t done = 0;
+
+  fd = open ((char*) name, O_RDONLY);
+  if ((fd == -1) || (fstat (fd, &st) == -1)) {
+    fprintf (stderr, "Error opening %s.\n", name);
+    exit (EXIT_FAILURE);
+  }
+
+  map -> addr = NULL;
+  map -> len = (size_t) st.st_size;
+  map -> mapped = false;
+  map -> section = false;
+  if (map -> len == 0) {
+    (void) close (fd);
+    return;
+  }
+
+  map -> addr = mmap (NULL, map -> len, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map -> addr != MAP_FAILED) {
+    map -> mapped = true;
+    adviseMap (map, access);
+  }
+  else {
+    map -> addr = wmalloc (map -> len);
+    while (done < map -> len) {
+      nbytes = read (fd, (unsigned char*) map -> addr + done, map -> len - done);
+      if (nbytes <= 0) {
+        fprintf (stderr, "Error reading %s.\n", name);
+        exit (EXIT_FAILURE);
+      }
+      done += (size_t) nbytes;
     }
+  }
+  (void) close (fd);
 
-    intsread = fread (file_info -> ws_buf, sizeof (unsigned int), OUTBUFMAX, file_info -> ws_fp);
-    file_info -> ws_end = file_info -> ws_buf + intsread;
-    file_info -> ws_p = file_info -> ws_buf;
+  return;
+}
 
-    if (intsread != fread (file_info -> cfm_buf, sizeof (unsigned int), OUTBUFMAX, file_info -> cfm_fp)) {
-      fprintf (stderr, "Case-folding modifier file size mismatch (%s, line %u).", __FILE__, __LINE__);
-      exit (EXIT_FAILURE);
+
+/*  Release map.  A section of a container is released with the
+**  container.  */
+void unmapFile (MAP_STRUCT *map) {
+  if ((map -> addr != NULL) && (map -> section == false)) {
+    if (map -> mapped == true) {
+      (void) munmap (map -> addr, map -> len);
     }
-    file_info -> cfm_end = file_info -> cfm_buf + intsread;
-    file_info -> cfm_p = file_info -> cfm_buf;
+    else {
+      wfree (map -> addr);
+    }
+  }
+  map -> addr = NULL;
+  map -> len = 0;
 
-    if (intsread != fread (file_info -> sm_buf, sizeof (unsigned int), OUTBUFMAX, file_info -> sm_fp)) {
-      fprintf (stderr, "Stemming modifier file size mismatch (%s, line %u).", __FILE__, __LINE__);
-      exit (EXIT_FAILURE);
+  return;
+}
+
+
+/*  The extension of the file name, without the dot  */
+static const char *partExt (const unsigned char *name) {
+  const char *dot = strrchr ((const char*) name, '.');
+
+  return ((dot == NULL) ? (const char*) name : dot + 1);
+}
+
+
+/*  Whether the file name can be read when decoding, either on its own
+**  or from the container  */
+bool hasPart (FILE_STRUCT *file_info, unsigned char *name) {
+  MAP_STRUCT section;
+
+  if (file_info -> in_container == true) {
+    if (containerSection (&file_info -> container_map, partExt (name), &section) == false) {
+      return (false);
     }
-    file_info -> sm_end = file_info -> sm_buf + intsread;
-    file_info -> sm_p = file_info -> sm_buf;
+    unmapFile (&section);
+    return (true);
+  }
+
+  return ((access ((char*) name, F_OK) == 0) ? true : false);
+}
+
+
+/*  Map the file name for decoding, from its section of the container
+**  if there is one, for the given access  */
+void mapPart (FILE_STRUCT *file_info, unsigned char *name, MAP_STRUCT *map, enum MAPACCESS access) {
+  if (file_info -> in_container == false) {
+    mapFile (name, map, access);
+    return;
+  }
+  if (containerSection (&file_info -> container_map, partExt (name), map) == false) {
+    fprintf (stderr, "%s has no section for %s (%s, line %u).\n", file_info -> ppc_name, name, __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+  adviseMap (map, access);
+
+  return;
+}
+
 
-    if (intsread != fread (file_info -> nws_buf, sizeof (unsigned int), OUTBUFMAX, file_info -> nws_fp)) {
-      fprintf (stderr, "Non-word sequence file size mismatch (%s, line %u).", __FILE__, __LINE__);
+/*  Map the four sequences (for decoding) and check that they are of
+**  the same length.  How they will be read is not known yet (see
+**  adviseSequences).  */
+static void mapSequences (FILE_STRUCT *file_info) {
+  mapPart (file_info, file_info -> ws_name, &file_info -> ws_map, ACCESS_NORMAL);
+  mapPart (file_info, file_info -> cfm_name, &file_info -> cfm_map, ACCESS_NORMAL);
+  mapPart (file_info, file_info -> sm_name, &file_info -> sm_map, ACCESS_NORMAL);
+  mapPart (file_info, file_info -> nws_name, &file_info -> nws_map, ACCESS_NORMAL);
+  file_info -> nsyms = symSeqInit (&file_info -> ws_sym, &file_info -> ws_map, SYMSEQ_WORD_MASK);
+
+  if (modSeqInit (&file_info -> cfm_mod, &file_info -> cfm_map) != file_info -> nsyms) {
+    fprintf (stderr, "Case-folding modifier file size mismatch (%s, line %u).", __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+  if (modSeqInit (&file_info -> sm_mod, &file_info -> sm_map) != file_info -> nsyms) {
+    fprintf (stderr, "Stemming modifier file size mismatch (%s, line %u).", __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+  if (symSeqInit (&file_info -> nws_sym, &file_info -> nws_map, 0xFFFFFFFFU) != file_info -> nsyms) {
+    fprintf (stderr, "Non-word sequence file size mismatch (%s, line %u).", __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+
+  /*  The surface forms are only used if both of their files exist  */
+  file_info -> has_surface = false;
+  if ((hasPart (file_info, file_info -> ss_name) == true) && (hasPart (file_info, file_info -> srf_name) == true)) {
+    mapPart (file_info, file_info -> ss_name, &file_info -> ss_map, ACCESS_NORMAL);
+    if (symSeqInit (&file_info -> ss_sym, &file_info -> ss_map, 0xFFFFFFFFU) != file_info -> nsyms) {
+      fprintf (stderr, "Surface sequence file size mismatch (%s, line %u).", __FILE__, __LINE__);
       exit (EXIT_FAILURE);
     }
-    file_info -> nws_end = file_info -> nws_buf + intsread;
-    file_info -> nws_p = file_info -> nws_buf;
+    file_info -> has_surface = true;
   }
 
-  *wrd_key = *file_info -> ws_p;
-#ifdef FLAG_WORDS
-  /*  Remove the top bit for all word keys  */
-  *wrd_key = *wrd_key & NO_TOP_BIT;
-#endif
-  *casefold_result = *file_info -> cfm_p;
-  *stem_result = *file_info -> sm_p;
-  *nonwrd_key = *file_info -> nws_p;
+  return;
+}
 
-  (file_info -> ws_p)++;
-  (file_info -> cfm_p)++;
-  (file_info -> sm_p)++;
-  (file_info -> nws_p)++;
-  intsread = 1;
 
-  return (intsread);
+/*  Tell the kernel how the mapped sequences are going to be read:
+**  sequentially when all of them are decoded  */
+void adviseSequences (FILE_STRUCT *file_info, enum MAPACCESS access) {
+  adviseMap (&file_info -> ws_map, access);
+  adviseMap (&file_info -> cfm_map, access);
+  adviseMap (&file_info -> sm_map, access);
+  adviseMap (&file_info -> nws_map, access);
+  if (file_info -> has_surface == true) {
+    adviseMap (&file_info -> ss_map, access);
+  }
+
+  return;
 }
 
 
 void openFiles (unsigned char *filename, FILE_STRUCT *file_info, const char *filemode, bool dicts_only) {
   unsigned int len = ustrlen (filename);
+  bool writing = (strcmp (filemode, "w") == 0) ? true : false;
+
+  file_info -> ppc_name = wmalloc (sizeof (unsigned char) * (len + 1 + 4));
+  ustrcpy (file_info -> ppc_name, filename);
+  ustrncat_const (file_info -> ppc_name, ".ppc", 4);
+  file_info -> ppc_name[len + 4] = '\0';
+  /*  A container from an earlier encoding would be read instead of the
+  **  new files; it is packed again after closing, if requested  */
+  file_info -> in_container = false;
+  if (writing == true) {
+    (void) unlink ((char*) file_info -> ppc_name);
+  }
+  else if (access ((char*) file_info -> ppc_name, F_OK) == 0) {
+    /*  Each section is advised on its own as it is used  */
+    mapFile (file_info -> ppc_name, &file_info -> container_map, ACCESS_NORMAL);
+    containerCheck (&file_info -> container_map, file_info -> ppc_name);
+    file_info -> in_container = true;
+  }
 
   file_info -> wd_name = wmalloc (sizeof (unsigned char) * (len + 1 + 3));
   ustrcpy (file_info -> wd_name, filename);
   ustrncat_const (file_info -> wd_name, ".wd", 3);
   file_info -> wd_name[len + 3] = '\0';
-  FOPEN (file_info -> wd_name, file_info -> wd_fp, filemode);
-  file_info -> wd_buf = wmalloc (sizeof (unsigned char) * OUTBUFMAX);
-  /*  Mark the end of the buffer (MAXWORDLEN + MAXWORDLEN_HEADER + 1)
-  **  from the actual end.  */
-  file_info -> wd_end = file_info -> wd_buf + OUTBUFMAX - (MAXWORDLEN + MAXWORDLEN_HEADER + 1);
+  /*  When decoding, fcodeDictDecode reads the dictionaries itself  */
+  if (writing == true) {
+    FOPEN (file_info -> wd_name, file_info -> wd_fp, filemode);
+    file_info -> wd_buf = wmalloc (sizeof (unsigned char) * OUTBUFMAX);
+    /*  Mark the end of the buffer (MAXWORDLEN + MAXWORDLEN_HEADER + 1)
+    **  from the actual end.  */
+    file_info -> wd_end = file_info -> wd_buf + OUTBUFMAX - (MAXWORDLEN + MAXWORDLEN_HEADER + 1);
+  }
 
   if (dicts_only == false) {
     file_info -> ws_name = wmalloc (sizeof (unsigned char) * (len + 1 + 3));
     ustrcpy (file_info -> ws_name, filename);
     ustrncat_const (file_info -> ws_name, ".ws", 3);
     file_info -> ws_name[len + 3] = '\0';
-    FOPEN (file_info -> ws_name, file_info -> ws_fp, filemode);
-    file_info -> ws_buf = wmalloc (sizeof (unsigned int) * OUTBUFMAX);
-    file_info -> ws_end = file_info -> ws_buf + OUTBUFMAX;
+    if (writing == true) {
+      FOPEN (file_info -> ws_name, file_info -> ws_fp, filemode);
+      file_info -> ws_buf = wmalloc (sizeof (unsigned int) * OUTBUFMAX);
+      file_info -> ws_end = file_info -> ws_buf + OUTBUFMAX;
+    }
   }
 
   file_info -> nwd_name = wmalloc (sizeof (unsigned char) * (len + 1 + 4));
   ustrcpy (file_info -> nwd_name, filename);
   ustrncat_const (file_info -> nwd_name, ".nwd", 4);
   file_info -> nwd_name[len + 4] = '\0';
-  FOPEN (file_info -> nwd_name, file_info -> nwd_fp, filemode);
-  file_info -> nwd_buf = wmalloc (sizeof (unsigned char) * OUTBUFMAX);
-  /*  Mark the end of the buffer (MAXWORDLEN + MAXWORDLEN_HEADER + 1)
-  **  from the actual end.  */
-  file_info -> nwd_end = file_info -> nwd_buf + OUTBUFMAX - (MAXWORDLEN + MAXWORDLEN_HEADER + 1);
+  if (writing == true) {
+    FOPEN (file_info -> nwd_name, file_info -> nwd_fp, filemode);
+    file_info -> nwd_buf = wmalloc (sizeof (unsigned char) * OUTBUFMAX);
+    /*  Mark the end of the buffer (MAXWORDLEN + MAXWORDLEN_HEADER + 1)
+    **  from the actual end.  */
+    file_info -> nwd_end = file_info -> nwd_buf + OUTBUFMAX - (MAXWORDLEN + MAXWORDLEN_HEADER + 1);
+  }
 
   if (dicts_only == false) {
     file_info -> nws_name = wmalloc (sizeof (unsigned char) * (len + 1 + 4));
     ustrcpy (file_info -> nws_name, filename);
     ustrncat_const (file_info -> nws_name, ".nws", 4);
     file_info -> nws_name[len + 4] = '\0';
-    FOPEN (file_info -> nws_name, file_info -> nws_fp, filemode);
-    file_info -> nws_buf = wmalloc (sizeof (unsigned int) * OUTBUFMAX);
-    file_info -> nws_end = file_info -> nws_buf + OUTBUFMAX;
+    if (writing == true) {
+      FOPEN (file_info -> nws_name, file_info -> nws_fp, filemode);
+      file_info -> nws_buf = wmalloc (sizeof (unsigned int) * OUTBUFMAX);
+      file_info -> nws_end = file_info -> nws_buf + OUTBUFMAX;
+    }
 
     file_info -> cfm_name = wmalloc (sizeof (unsigned char) * (len + 1 + 4));
     ustrcpy (file_info -> cfm_name, filename);
     ustrncat_const (file_info -> cfm_name, ".cfm", 4);
     file_info -> cfm_name[len + 4] = '\0';
-    FOPEN (file_info -> cfm_name, file_info -> cfm_fp, filemode);
-    file_info -> cfm_buf = wmalloc (sizeof (unsigned int) * OUTBUFMAX);
-    file_info -> cfm_end = file_info -> cfm_buf + OUTBUFMAX;
+    if (writing == true) {
+      FOPEN (file_info -> cfm_name, file_info -> cfm_fp, filemode);
+      file_info -> cfm_buf = wmalloc (sizeof (unsigned int) * OUTBUFMAX);
+      file_info -> cfm_end = file_info -> cfm_buf + OUTBUFMAX;
+    }
+
+    file_info -> cfx_name = wmalloc (sizeof (unsigned char) * (len + 1 + 4));
+    ustrcpy (file_info -> cfx_name, filename);
+    ustrncat_const (file_info -> cfx_name, ".cfx", 4);
+    file_info -> cfx_name[len + 4] = '\0';
+    if (writing == true) {
+      (void) unlink ((char*) file_info -> cfx_name);
+    }
 
     file_info -> sm_name = wmalloc (sizeof (unsigned char) * (len + 1 + 3));
     ustrcpy (file_info -> sm_name, filename);
     ustrncat_const (file_info -> sm_name, ".sm", 3);
     file_info -> sm_name[len + 3] = '\0';
-    FOPEN (file_info -> sm_name, file_info -> sm_fp, filemode);
-    file_info -> sm_buf = wmalloc (sizeof (unsigned int) * OUTBUFMAX);
-    file_info -> sm_end = file_info -> sm_buf + OUTBUFMAX;
+    if (writing == true) {
+      FOPEN (file_info -> sm_name, file_info -> sm_fp, filemode);
+      file_info -> sm_buf = wmalloc (sizeof (unsigned int) * OUTBUFMAX);
+      file_info -> sm_end = file_info -> sm_buf + OUTBUFMAX;
+    }
+
+    file_info -> srf_name = wmalloc (sizeof (unsigned char) * (len + 1 + 4));
+    ustrcpy (file_info -> srf_name, filename);
+    ustrncat_const (file_info -> srf_name, ".srf", 4);
+    file_info -> srf_name[len + 4] = '\0';
+    file_info -> ss_name = wmalloc (sizeof (unsigned char) * (len + 1 + 3));
+    ustrcpy (file_info -> ss_name, filename);
+    ustrncat_const (file_info -> ss_name, ".ss", 3);
+    file_info -> ss_name[len + 3] = '\0';
+    /*  Surface forms from an earlier encoding would no longer match;
+    **  they are written again after closing, if requested  */
+    if (writing == true) {
+      (void) unlink ((char*) file_info -> srf_name);
+      (void) unlink ((char*) file_info -> ss_name);
+    }
   }
 
-  if (strcmp (filemode, "w") == 0) {
+  if (writing == true) {
     file_info -> wd_p = file_info -> wd_buf;
     file_info -> ws_p = file_info -> ws_buf;
     file_info -> nwd_p = file_info -> nwd_buf;
@@ -242,93 +472,94 @@ void openFiles (unsigned char *filename, FILE_STRUCT *file_info, const char *fil
     file_info -> sm_p = file_info -> sm_buf;
   }
   else {
-    file_info -> wd_p = file_info -> wd_end;
-    file_info -> ws_p = file_info -> ws_end;
-    file_info -> nwd_p = file_info -> nwd_end;
-    file_info -> nws_p = file_info -> nws_end;
-    file_info -> cfm_p = file_info -> cfm_end;
-    file_info -> sm_p = file_info -> sm_end;
+    if (dicts_only == false) {
+      mapSequences (file_info);
+    }
   }
 
   return;
 }
 
 
-/*  Re-encode the sequence file.  */
-void seqReEncode (FILE_STRUCT *file_info, unsigned int *map, enum WORDTYPE type) {
-  char *temp_mv;
-  unsigned char *temp_file;
-  FILE *temp_fp;
-  unsigned int buffsize;
-  unsigned int i;
+/*  Replace every symbol of the sequence p, of length n, with its new
+**  id from map.  */
+void remapSequence (unsigned int *p, size_t n, unsigned int *map) {
+  size_t i = 0;
 
+#ifdef FLAG_WORDS
+  for (i = 0; i < n; i++) {
+    if ((*p & NO_TOP_BIT) == *p) {
+      /*  top bit not set  */
+      *p = map[*p];
+    }
+    else {
+      /*  top bit is set  */
+      *p = map[*p & NO_TOP_BIT];
+      *p = *p | TOP_BIT;
+    }
+    p++;
+  }
+#else
+  for (i = 0; i < n; i++) {
+    *p = map[*p];
+    p++;
+  }
+#endif
+
+  return;
+}
+
+
+/*  Re-encode the sequence file in place.  The file is memory-mapped
+**  if possible; otherwise, it is rewritten a buffer at a time.  */
+void seqReEncode (FILE_STRUCT *file_info, unsigned int *map, enum WORDTYPE type) {
   unsigned char *name;
-  FILE *fp;
   unsigned int *buf = NULL;
-  unsigned int *p = NULL;
+  unsigned int *seq = NULL;
+  int fd = -1;
+  struct stat st;
+  size_t n = 0;
+  off_t offset = 0;
+  ssize_t nbytes = 0;
 
-  int result = 0;
-
-  temp_file = wmalloc (sizeof (unsigned char) * 9);
   map[0] = 0;
   if (type == ISWORD) {
     name = file_info -> ws_name;
-    fp = file_info -> ws_fp;
     buf = file_info -> ws_buf;
-    ustrcpy_const (temp_file, "temp.ws");
-    temp_file[7] = '\0';
   }
   else {
     name = file_info -> nws_name;
-    fp = file_info -> nws_fp;
     buf = file_info -> nws_buf;
-    ustrcpy_const (temp_file, "temp.nws");
-    temp_file[8] = '\0';
   }
 
-  temp_mv = wmalloc (ustrlen (name) + ustrlen (temp_file) + 5);
-  sprintf (temp_mv, "mv %s %s", name, temp_file);
-  result = system (temp_mv);
-  if (result == -1) {
-    fprintf (stderr, "EE\tError in execution of the 'mv' command!");
+  fd = open ((char*) name, O_RDWR);
+  if ((fd == -1) || (fstat (fd, &st) == -1)) {
+    fprintf (stderr, "Error opening %s.\n", name);
+    exit (EXIT_FAILURE);
+  }
+  n = (size_t) st.st_size / sizeof (unsigned int);
+  if (n == 0) {
+    (void) close (fd);
+    return;
   }
 
-  FOPEN (temp_file, temp_fp, "r");
-  FOPEN (name, fp, "w");
-  do {
-    buffsize = fread (buf, sizeof (unsigned int), OUTBUFMAX, temp_fp);
-    p = buf;
-#ifdef FLAG_WORDS
-    for (i = 0; i < buffsize; i++) {
-      if ((*p & NO_TOP_BIT) == *p) {
-  /*  top bit not set  */
-  *p = map[*p];
-      }
-      else {
-  /*  top bit is set  */
-  *p = map[*p & NO_TOP_BIT];
-  *p = *p | TOP_BIT;
+  seq = mmap (NULL, n * sizeof (unsigned int), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (seq != MAP_FAILED) {
+    (void) madvise (seq, n * sizeof (unsigned int), MADV_SEQUENTIAL);
+    remapSequence (seq, n, map);
+    (void) munmap (seq, n * sizeof (unsigned int));
+  }
+  else {
+    while ((nbytes = pread (fd, buf, sizeof (unsigned int) * OUTBUFMAX, offset)) > 0) {
+      remapSequence (buf, (size_t) nbytes / sizeof (unsigned int), map);
+      if (pwrite (fd, buf, (size_t) nbytes, offset) != nbytes) {
+        fprintf (stderr, "Error writing %s.\n", name);
+        exit (EXIT_FAILURE);
       }
-      p++;
-    }
-#else
-    for (i = 0; i < buffsize; i++) {
-      *p = map[*p];
-      p++;
+      offset += nbytes;
     }
-#endif
-    fwrite (buf, sizeof (unsigned int), buffsize, fp);
-  } while (!feof (temp_fp));
-  fclose (temp_fp);
-
-  sprintf (temp_mv, "rm %s", temp_file);
-  result = system (temp_mv);
-  if (result == -1) {
-    fprintf (stderr, "EE\tError in execution of the 'mv' command!");
   }
-
-  wfree (temp_mv);
-  fclose (fp);
+  (void) close (fd);
 
   return;
 }
@@ -348,6 +579,9 @@ void closeFilesEncode (FILE_STRUCT *file_info, unsigned int *word_map, unsigned
   }
   fclose (file_info -> ws_fp);
   seqReEncode (file_info, word_map, ISWORD);
+  if (file_info -> seq_width != sizeof (unsigned int)) {
+    symSeqWiden (file_info -> ws_name, file_info -> seq_width, SYMSEQ_WORD_MASK);
+  }
   wfree (file_info -> ws_name);
   wfree (file_info -> ws_buf);
 
@@ -363,6 +597,9 @@ void closeFilesEncode (FILE_STRUCT *file_info, unsigned int *word_map, unsigned
   }
   fclose (file_info -> nws_fp);
   seqReEncode (file_info, nonword_map, ISNONWORD);
+  if (file_info -> seq_width != sizeof (unsigned int)) {
+    symSeqWiden (file_info -> nws_name, file_info -> seq_width, 0xFFFFFFFFU);
+  }
   wfree (file_info -> nws_name);
   wfree (file_info -> nws_buf);
 
@@ -370,64 +607,436 @@ void closeFilesEncode (FILE_STRUCT *file_info, unsigned int *word_map, unsigned
     fwrite (file_info -> cfm_buf, sizeof (unsigned int), (file_info -> cfm_p) - (file_info -> cfm_buf), file_info -> cfm_fp);
   }
   fclose (file_info -> cfm_fp);
+  if (file_info -> compact_mods == true) {
+    modSeqCompact (file_info -> cfm_name);
+  }
   wfree (file_info -> cfm_name);
   wfree (file_info -> cfm_buf);
+  wfree (file_info -> cfx_name);
 
   if (file_info -> sm_p != file_info -> sm_buf) {
     fwrite (file_info -> sm_buf, sizeof (unsigned int), (file_info -> sm_p) - (file_info -> sm_buf), file_info -> sm_fp);
   }
   fclose (file_info -> sm_fp);
+  if (file_info -> compact_mods == true) {
+    modSeqCompact (file_info -> sm_name);
+  }
   wfree (file_info -> sm_name);
   wfree (file_info -> sm_buf);
 
+  wfree (file_info -> srf_name);
+  wfree (file_info -> ss_name);
+  wfree (file_info -> ppc_name);
+
   return;
 }
 
 
 void closeFilesDecode (FILE_STRUCT *file_info, WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info) {
-  fclose (file_info -> wd_fp);
   wfree (file_info -> wd_name);
-  wfree (file_info -> wd_buf);
 
-  fclose (file_info -> ws_fp);
+  unmapFile (&file_info -> ws_map);
   wfree (file_info -> ws_name);
-  wfree (file_info -> ws_buf);
 
-  fclose (file_info -> nwd_fp);
   wfree (file_info -> nwd_name);
-  wfree (file_info -> nwd_buf);
 
-  fclose (file_info -> nws_fp);
+  unmapFile (&file_info -> nws_map);
   wfree (file_info -> nws_name);
-  wfree (file_info -> nws_buf);
 
-  fclose (file_info -> cfm_fp);
+  unmapFile (&file_info -> cfm_map);
   wfree (file_info -> cfm_name);
-  wfree (file_info -> cfm_buf);
+  wfree (file_info -> cfx_name);
 
-  fclose (file_info -> sm_fp);
+  unmapFile (&file_info -> sm_map);
   wfree (file_info -> sm_name);
-  wfree (file_info -> sm_buf);
+
+  if (file_info -> has_surface == true) {
+    unmapFile (&file_info -> ss_map);
+  }
+  wfree (file_info -> srf_name);
+  wfree (file_info -> ss_name);
+
+  /*  Flat dictionaries used in place from the container (see
+  **  flatDictLoad) cannot be used after this  */
+  if (file_info -> in_container == true) {
+    unmapFile (&file_info -> container_map);
+  }
+  wfree (file_info -> ppc_name);
 
   return;
 }
 
 
 /*
-**  Process the file
+**  Write the patterns of case of word_info, in the order of their ids,
+**  to ".cfx" as a flat dictionary (see fcode.h).  Nothing is written
+**  if no word needed one.
 */
-void fileEncode (FILE_STRUCT *file_info, FILE *fp, WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info) {
-  unsigned char *wrd_buff;
+void writeCasePatterns (FILE_STRUCT *file_info, WORD_STRUCT *word_info) {
+  FCODENODE *nodes = NULL;
+  FCODEENTRY *entry = NULL;
+  unsigned int i = 0;
+
+  if ((word_info -> case_hash == NULL) || (word_info -> ncases == FIRST_FCODE)) {
+    return;
+  }
+
+  nodes = wmalloc (sizeof (FCODENODE) * word_info -> ncases);
+  for (i = FIRST_FCODE; i < word_info -> ncases; i++) {
+    entry = &(word_info -> case_hash -> entries[i]);
+    nodes[i].item = word_info -> case_hash -> pool + entry -> offset;
+    nodes[i].len = entry -> len;
+  }
+  fcodeFlatDictWrite (file_info -> cfx_name, nodes, word_info -> ncases);
+  wfree (nodes);
+
+  return;
+}
+
+
+/*  Load the patterns of case (".cfx") for decoding.  Returns NULL if
+**  there are none.  */
+FCODEDICT *loadCasePatterns (FILE_STRUCT *file_info) {
+  FCODEDICT *cases = NULL;
+
+  if (hasPart (file_info, file_info -> cfx_name) == false) {
+    return (NULL);
+  }
+  cases = wmalloc (sizeof (FCODEDICT));
+  (void) fcodeDictDecodePart (file_info, file_info -> cfx_name, cases);
+
+  return (cases);
+}
+
+
+/*  Allocate the scratch space used by parseRecord  */
+void initParse (PARSE_STRUCT *parse, unsigned int maxword) {
+  parse -> m = wmalloc (sizeof (unsigned int) * maxword);
+  parse -> wrd_buff = wmalloc (sizeof (unsigned char) * maxword);
+  parse -> wrd_buff_len = 0;
+  parse -> nonwrd_buff = wmalloc (sizeof (unsigned char) * maxword);
+  parse -> nonwrd_buff_len = 0;
+  parse -> notdone = false;
+
+  return;
+}
+
+
+void freeParse (PARSE_STRUCT *parse) {
+  wfree (parse -> nonwrd_buff);
+  wfree (parse -> wrd_buff);
+  wfree (parse -> m);
+
+  return;
+}
+
+
+/*
+**  Release the lexicons and dictionaries of word_info and nonword_info
+**  (but not their statistics).  The splay tree nodes are all in the
+**  arenas, so they go at once.
+*/
+void freeLexicons (WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info) {
+  freeStemCache (word_info);
+
+  if (word_info -> hash_fc != NULL) {
+    fcodeHashFree (word_info -> hash_fc);
+    word_info -> hash_fc = NULL;
+  }
+  if (word_info -> dict_fc != NULL) {
+    wfree (word_info -> dict_fc);
+    word_info -> dict_fc = NULL;
+  }
+  if (word_info -> pool_fc != NULL) {
+    fcodeDictFree (word_info -> pool_fc);
+    word_info -> pool_fc = NULL;
+  }
+  if (word_info -> surface_fc != NULL) {
+    fcodeDictFree (word_info -> surface_fc);
+    word_info -> surface_fc = NULL;
+  }
+  if (word_info -> case_hash != NULL) {
+    fcodeHashFree (word_info -> case_hash);
+    word_info -> case_hash = NULL;
+  }
+  if (word_info -> case_fc != NULL) {
+    fcodeDictFree (word_info -> case_fc);
+    word_info -> case_fc = NULL;
+  }
+  if (word_info -> map != NULL) {
+    wfree (word_info -> map);
+    word_info -> map = NULL;
+  }
+  wmArenaFree (word_info -> arena_fc);
+  word_info -> arena_fc = NULL;
+  word_info -> root_fc = NULL;
+
+  if (nonword_info -> hash_fc != NULL) {
+    fcodeHashFree (nonword_info -> hash_fc);
+    nonword_info -> hash_fc = NULL;
+  }
+  if (nonword_info -> dict_fc != NULL) {
+    wfree (nonword_info -> dict_fc);
+    nonword_info -> dict_fc = NULL;
+  }
+  if (nonword_info -> pool_fc != NULL) {
+    fcodeDictFree (nonword_info -> pool_fc);
+    nonword_info -> pool_fc = NULL;
+  }
+  if (nonword_info -> map != NULL) {
+    wfree (nonword_info -> map);
+    nonword_info -> map = NULL;
+  }
+  wmArenaFree (nonword_info -> arena_fc);
+  nonword_info -> arena_fc = NULL;
+  nonword_info -> root_fc = NULL;
+
+  return;
+}
+
+
+void freeStemCache (WORD_STRUCT *word_info) {
+  if (word_info -> stem_cache != NULL) {
+    fcodeHashFree (word_info -> stem_cache -> surface);
+    wfree (word_info -> stem_cache -> entries);
+    wfree (word_info -> stem_cache);
+    word_info -> stem_cache = NULL;
+  }
+
+  return;
+}
+
+
+/*
+**  Case-fold the word w of length len and return its modifier.  The
+**  case of a word which needs a pattern is looked up in (or added to)
+**  the patterns of word_info.
+*/
+static unsigned int foldWord (WORD_STRUCT *word_info, unsigned char *w, unsigned int len) {
+  unsigned char pattern[CASEFOLD_PATTERN_MAX];
+  unsigned long long cmps = 0;
+  unsigned long long pattern_total = 0;
+  unsigned int pattern_len = 0;
+  unsigned int modifier = casefold (w, len);
+
+  if (modifier == CASEFOLD_PATTERN) {
+    pattern_len = casefoldPattern (w, len, pattern);
+    if (word_info -> ncases > UINT_MAX - CASEFOLD_PATTERN) {
+      fprintf (stderr, "Too many patterns of case (%s, line %u).\n", __FILE__, __LINE__);
+      exit (EXIT_FAILURE);
+    }
+    modifier = CASEFOLD_PATTERN + fcodeHashEncode (pattern, pattern_len, word_info -> case_hash, &word_info -> ncases, &cmps, &pattern_total);
+  }
+
+  return (modifier);
+}
+
+
+/*  If the record being parsed is sampled (SAMPLE is true), charge the
+**  time since the mark T to PHASE of W and move the mark  */
+#define SAMPLEPHASE(SAMPLE,W,PHASE,T) \
+  do { \
+    if ((SAMPLE) == true) { \
+      unsigned long long sample_now = statsClock (); \
+      (W) -> sample_ns[PHASE] += sample_now - (T); \
+      (W) -> sample_marks[PHASE]++; \
+      (T) = sample_now; \
+    } \
+  } while (0)
+
+
+/*
+**  Case-fold and stem the word w of length *len (as requested) and
+**  return its id in the lexicon.  A surface form which has been seen
+**  before is looked up in the stem cache instead, and only its
+**  frequency in the lexicon is updated.  *len is set to the length of
+**  the stemmed word, but w is only changed on a miss.  For a sampled
+**  record, the insertion into the lexicon on a miss is charged to its
+**  own phase, from the mark *mark.
+*/
+static unsigned int cachedWordKey (WORD_STRUCT *word_info, PARSE_STRUCT *parse, unsigned char *w, unsigned int *len, unsigned int *casefold_result, unsigned int *stem_result, bool sample, unsigned long long *mark) {
+  STEMCACHE *cache = word_info -> stem_cache;
+  STEMCACHEENTRY *entry = NULL;
+  unsigned long long surface_len = 0;
+  unsigned int id = 0;
+  unsigned int nsurface = cache -> nsurface;
+
+  id = fcodeHashEncode (w, *len, cache -> surface, &cache -> nsurface, &word_info -> cache_cmps, &surface_len);
+  if (id == EMPTY_FCODE) {
+    /*  Zero-length words are not cached  */
+    if (word_info -> docasefold) {
+      *casefold_result = foldWord (word_info, w, *len);
+    }
+    return (EMPTY_FCODE);
+  }
+
+  if (id < nsurface) {
+    entry = &(cache -> entries[id]);
+    (word_info -> hash_fc -> entries[entry -> key].freq)++;
+    (word_info -> cache_hits)++;
+  }
+  else {
+    if (id >= cache -> size) {
+      cache -> size = cache -> size << 1;
+      cache -> entries = wrealloc (cache -> entries, sizeof (STEMCACHEENTRY) * cache -> size);
+    }
+    entry = &(cache -> entries[id]);
+    entry -> casefold = 0;
+    entry -> stem = 0;
+    if (word_info -> docasefold) {
+      entry -> casefold = foldWord (word_info, w, *len);
+    }
+    if (word_info -> dostem) {
+      entry -> stem = stem (w, len, parse -> m);
+    }
+    entry -> len = *len;
+    SAMPLEPHASE (sample, word_info, PHASE_NORMALIZE, *mark);
+    entry -> key = fcodeHashEncode (w, *len, word_info -> hash_fc, &word_info -> nwords, &word_info -> cmps, &word_info -> total_words_len);
+    SAMPLEPHASE (sample, word_info, PHASE_LEXICON, *mark);
+  }
+
+  *casefold_result = entry -> casefold;
+  *stem_result = entry -> stem;
+  *len = entry -> len;
+
+  return (entry -> key);
+}
+
+
+/*
+**  Parse the next word and nonword from the buffer, case-fold and stem
+**  the word (if requested) and look both up in the lexicons of
+**  word_info and nonword_info.  The four values of the record are
+**  returned through the last four arguments.  Any token left
+**  unfinished (because of its length or the end of the buffer) is
+**  recorded in parse -> notdone for the next call.  With
+**  word_info -> sample_phases set, the phases of one record in every
+**  PHASE_SAMPLE_RATE are timed; reading the clock for every record
+**  would cost more than some of the phases themselves.
+*/
+void parseRecord (unsigned char **src_p, unsigned char *src_end, WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info, PARSE_STRUCT *parse, unsigned int *wrd_key, unsigned int *casefold_result, unsigned int *stem_result, unsigned int *nonwrd_key) {
+  unsigned char *wrd_buff = parse -> wrd_buff;
+  unsigned char *nonwrd_buff = parse -> nonwrd_buff;
   unsigned int wrd_buff_len = 0;
-                    /*  The original word buffer length, before stemming  */
-  unsigned char *nonwrd_buff;
   unsigned int nonwrd_buff_len = 0;
+  bool sample = false;
+  unsigned long long mark = 0;
+#ifdef FLAG_WORDS
+  bool end_phrase = false;
+#endif
+
+  *casefold_result = 0;
+  *stem_result = 0;
+
+  if (word_info -> sample_phases == true) {
+    (word_info -> sample_countdown)--;
+    if (word_info -> sample_countdown == 0) {
+      word_info -> sample_countdown = PHASE_SAMPLE_RATE;
+      sample = true;
+      mark = statsClock ();
+    }
+  }
+
+  if (parse -> notdone == false) {
+    wrd_buff_len = getWord (src_p, src_end, wrd_buff, word_info -> maxword, &parse -> notdone, &word_info -> long_tokens, &word_info -> enforce_tags);
+    SAMPLEPHASE (sample, word_info, PHASE_TOKENIZE, mark);
+    if (word_info -> stem_cache != NULL) {
+      /*  A lookup in the stem cache stands in for normalising  */
+      *wrd_key = cachedWordKey (word_info, parse, wrd_buff, &wrd_buff_len, casefold_result, stem_result, sample, &mark);
+      (word_info -> total_length) += wrd_buff_len;
+      SAMPLEPHASE (sample, word_info, PHASE_NORMALIZE, mark);
+    }
+    else {
+      if (word_info -> docasefold) {
+        *casefold_result = foldWord (word_info, wrd_buff, wrd_buff_len);
+      }
+      if (word_info -> dostem) {
+        *stem_result = stem (wrd_buff, &wrd_buff_len, parse -> m);
+      }
+      (word_info -> total_length) += wrd_buff_len;
+      SAMPLEPHASE (sample, word_info, PHASE_NORMALIZE, mark);
+      if (word_info -> hash_fc != NULL) {
+        *wrd_key = fcodeHashEncode (wrd_buff, wrd_buff_len, word_info -> hash_fc, &word_info -> nwords, &word_info -> cmps, &word_info -> total_words_len);
+      }
+      else {
+        *wrd_key = fcodeEncode (wrd_buff, wrd_buff_len, &word_info -> root_fc, word_info -> arena_fc, &word_info -> nwords, &word_info -> cmps, &word_info -> total_words_len);
+      }
+      SAMPLEPHASE (sample, word_info, PHASE_LEXICON, mark);
+    }
+  }
+  else {
+    *wrd_key = EMPTY_FCODE;
+    parse -> notdone = false;
+  }
+  (word_info -> total_tokens)++;
+
+  if ((parse -> notdone == false) && (*src_p != src_end)) {
+    nonwrd_buff_len = getNonWord (src_p, src_end, nonwrd_buff, nonword_info -> maxnonword, &parse -> notdone, &nonword_info -> long_tokens);
+    SAMPLEPHASE (sample, word_info, PHASE_TOKENIZE, mark);
+#ifdef FLAG_WORDS
+    if ((nonwrd_buff[0] == '.') || (nonwrd_buff[0] == ',') ||
+        (nonwrd_buff[0] == ';') || (nonwrd_buff[0] == '?') ||
+        (nonwrd_buff[0] == '!') || (nonwrd_buff[0] == ':') ||
+  ((nonwrd_buff_len >= 4) && (nonwrd_buff[1] == '-') &&
+         (nonwrd_buff[2] == '-') && (isspace (nonwrd_buff[0]))
+   && (isspace (nonwrd_buff[3])))) {
+      end_phrase = true;
+    }
+#endif
+    (nonword_info -> total_length) += nonwrd_buff_len;
+    if (nonword_info -> hash_fc != NULL) {
+      *nonwrd_key = fcodeHashEncode (nonwrd_buff, nonwrd_buff_len, nonword_info -> hash_fc, &nonword_info -> nnonwords, &nonword_info -> cmps, &nonword_info -> total_nonwords_len);
+    }
+    else {
+      *nonwrd_key = fcodeEncode (nonwrd_buff, nonwrd_buff_len, &nonword_info -> root_fc, nonword_info -> arena_fc, &nonword_info -> nnonwords, &nonword_info -> cmps, &nonword_info -> total_nonwords_len);
+    }
+    SAMPLEPHASE (sample, word_info, PHASE_LEXICON, mark);
+  }
+  else {
+    *nonwrd_key = EMPTY_FCODE;
+    parse -> notdone = false;
+  }
+  (nonword_info -> total_tokens)++;
+
+#ifdef FLAG_WORDS
+  /*  The flag takes the top bit of the id  */
+  if ((*wrd_key & TOP_BIT) != 0) {
+    fprintf (stderr, "Too many distinct words for FLAG_WORDS (%s, line %u).\n", __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+  if (end_phrase == true) {
+    *wrd_key = *wrd_key | TOP_BIT;
+  }
+#endif
+
+  if (*wrd_key == EMPTY_FCODE) {
+    (word_info -> zerolength_sym)++;
+  }
+
+  if (*nonwrd_key == EMPTY_FCODE) {
+    (nonword_info -> zerolength_sym)++;
+  }
+
+  if (sample == true) {
+    (word_info -> sampled)++;
+  }
+
+  parse -> wrd_buff_len = wrd_buff_len;
+  parse -> nonwrd_buff_len = nonwrd_buff_len;
+
+  return;
+}
+
+
+/*
+**  Process the file
+*/
+void fileEncode (FILE_STRUCT *file_info, FILE *fp, WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info) {
+  PARSE_STRUCT parse;
   unsigned int wrd_key = 0;
   unsigned int nonwrd_key = 0;
   unsigned int casefold_result = 0;
   unsigned int stem_result = 0;
-  unsigned int *m = NULL;
-  bool notdone = false;
 
 #ifdef CHARSTATS
   unsigned int wrd_array[MAXPRIMS];
@@ -441,9 +1050,6 @@ void fileEncode (FILE_STRUCT *file_info, FILE *fp, WORD_STRUCT *word_info, NONWO
   unsigned int num_read = 0;
   unsigned int space_area = 0;
   unsigned int text_area = 0;
-#ifdef FLAG_WORDS
-  bool end_phrase = false;
-#endif
 
 #ifdef CHARSTATS
   for (i = 0; i < MAXPRIMS; i++) {
@@ -452,82 +1058,29 @@ void fileEncode (FILE_STRUCT *file_info, FILE *fp, WORD_STRUCT *word_info, NONWO
   }
 #endif
 
-  m = wmalloc (sizeof (unsigned int) * word_info -> maxword);
-  wrd_buff = wmalloc (sizeof (unsigned char) * word_info -> maxword);
-  nonwrd_buff = wmalloc (sizeof (unsigned char) * word_info -> maxword);
+  initParse (&parse, word_info -> maxword);
   src_buff = wmalloc (sizeof (unsigned char) * (INIT_BUFF_SIZE + 1));
 
   num_read = fread (src_buff, sizeof (unsigned char), INIT_BUFF_SIZE, fp);
+  file_info -> bytes_in += num_read;
   src_p = src_buff;
   src_end = src_buff + num_read;
 
   do {
-    if (notdone == false) {
-      wrd_buff_len = getWord (&src_p, src_end, wrd_buff, word_info -> maxword, &notdone, &word_info -> long_tokens, &word_info -> enforce_tags);
-      if (word_info -> docasefold) {
-        casefold_result = casefold (wrd_buff, wrd_buff_len);
-      }
-      if (word_info -> dostem) {
-        stem_result = stem (wrd_buff, &wrd_buff_len, m);
-      }
-      (word_info -> total_length) += wrd_buff_len;
-      wrd_key = fcodeEncode (wrd_buff, wrd_buff_len, &word_info -> root_fc, &word_info -> nwords, &word_info -> cmps, &word_info -> total_words_len);
-    }
-    else {
-      wrd_key = EMPTY_FCODE;
-      casefold_result = 0;
-      stem_result = 0;
-      notdone = false;
-    }
-    (word_info -> total_tokens)++;
-
-    if ((notdone == false) && (src_p != src_end)) {
-      nonwrd_buff_len = getNonWord (&src_p, src_end, nonwrd_buff, nonword_info -> maxnonword, &notdone, &nonword_info -> long_tokens);
-#ifdef FLAG_WORDS
-      if ((nonwrd_buff[0] == '.') || (nonwrd_buff[0] == ',') ||
-          (nonwrd_buff[0] == ';') || (nonwrd_buff[0] == '?') ||
-          (nonwrd_buff[0] == '!') || (nonwrd_buff[0] == ':') ||
-    ((nonwrd_buff_len >= 4) && (nonwrd_buff[1] == '-') &&
-           (nonwrd_buff[2] == '-') && (isspace (nonwrd_buff[0]))
-     && (isspace (nonwrd_buff[3])))) {
-  end_phrase = true;
-      }
-#endif
-      (nonword_info -> total_length) += nonwrd_buff_len;
-      nonwrd_key = fcodeEncode (nonwrd_buff, nonwrd_buff_len, &nonword_info -> root_fc, &nonword_info -> nnonwords, &nonword_info -> cmps, &nonword_info -> total_nonwords_len);
-    }
-    else {
-      nonwrd_key = EMPTY_FCODE;
-      notdone = false;
-    }
-    (nonword_info -> total_tokens)++;
+    parseRecord (&src_p, src_end, word_info, nonword_info, &parse, &wrd_key, &casefold_result, &stem_result, &nonwrd_key);
 
 #ifdef CHARSTATS
-    for (i = 0; i < wrd_buff_len; i++) {
-      if (wrd_array[wrd_buff[i]] == 0) {
-        wrd_array[wrd_buff[i]] = 1;
+    for (i = 0; i < parse.wrd_buff_len; i++) {
+      if (wrd_array[parse.wrd_buff[i]] == 0) {
+        wrd_array[parse.wrd_buff[i]] = 1;
       }
     }
-    for (i = 0; i < nonwrd_buff_len; i++) {
-      if (nonwrd_array[nonwrd_buff[i]] == 0) {
-        nonwrd_array[nonwrd_buff[i]] = 1;
+    for (i = 0; i < parse.nonwrd_buff_len; i++) {
+      if (nonwrd_array[parse.nonwrd_buff[i]] == 0) {
+        nonwrd_array[parse.nonwrd_buff[i]] = 1;
       }
     }
 #endif
-#ifdef FLAG_WORDS
-    if (end_phrase == true) {
-      wrd_key = wrd_key | TOP_BIT;
-      end_phrase = false;
-    }
-#endif
-
-    if (wrd_key == EMPTY_FCODE) {
-      (word_info -> zerolength_sym)++;
-    }
-
-    if (nonwrd_key == EMPTY_FCODE) {
-      (nonword_info -> zerolength_sym)++;
-    }
 
     writeFiles (file_info, wrd_key, casefold_result, stem_result, nonwrd_key);
 
@@ -537,6 +1090,7 @@ void fileEncode (FILE_STRUCT *file_info, FILE *fp, WORD_STRUCT *word_info, NONWO
     if ((text_area < MIN_BUFF_SIZE) && (!feof (fp))) {
       memcpy (src_buff, src_p, text_area);
       num_read = fread (src_buff + text_area, sizeof (unsigned char), space_area, fp);
+      file_info -> bytes_in += num_read;
       src_p = src_buff;
       src_end = src_buff + text_area + num_read;
     }
@@ -560,16 +1114,20 @@ void fileEncode (FILE_STRUCT *file_info, FILE *fp, WORD_STRUCT *word_info, NONWO
   nonword_info -> nnonwords_prims = nprims;
 #endif
 
-  wfree (nonwrd_buff);
-  wfree (wrd_buff);
-  wfree (m);
+  wfree (src_buff);
+  freeParse (&parse);
 
   return;
 }
 
 
-void fileDecode (FILE_STRUCT *file_info, FILE *fp, WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info) {
-  unsigned char *wrd;
+/*
+**  Decode records [start, end) of the sequences into the buffer out.
+**  Each record depends only on its four values and the dictionaries,
+**  so decoding can begin anywhere.
+*/
+static void decodeRecords (FILE_STRUCT *file_info, WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info, size_t start, size_t end, OUT_BUF *out) {
+  unsigned char *item;
   unsigned int wrd_len;
   unsigned int wrd_key;
   unsigned int casefold_mod;
@@ -577,48 +1135,77 @@ void fileDecode (FILE_STRUCT *file_info, FILE *fp, WORD_STRUCT *word_info, NONWO
   unsigned char *nonwrd;
   unsigned int nonwrd_len;
   unsigned int nonwrd_key;
-  unsigned char *space;
-  unsigned int space_len = 0;
-  unsigned char *newline;
-  unsigned int newline_len = 0;
-
-  wrd = wmalloc (sizeof (unsigned char) * word_info -> maxword);
-  nonwrd = wmalloc (sizeof (unsigned char) * nonword_info -> maxnonword);
-  space = wmalloc (sizeof (unsigned char) * nonword_info -> maxnonword);
-  newline = wmalloc ((sizeof (unsigned char) * nonword_info -> maxnonword));
-
-  if (file_info -> mode == MODE_DECODE) {
-    while (readFiles (file_info, &wrd_key, &casefold_mod, &stem_mod, &nonwrd_key) != 0) {
-      wrd_key = wrd_key & NO_TOP_BIT;
+  const SYM_SEQ *ws_sym = &file_info -> ws_sym;
+  const MOD_SEQ *cfm_mod = &file_info -> cfm_mod;
+  const MOD_SEQ *sm_mod = &file_info -> sm_mod;
+  const SYM_SEQ *nws_sym = &file_info -> nws_sym;
+  const FCODEDICT *wrd_dict = word_info -> pool_fc;
+  const FCODEDICT *nonwrd_dict = nonword_info -> pool_fc;
+  const FCODEDICT *surface_dict = word_info -> surface_fc;
+  const SYM_SEQ *ss_sym = &file_info -> ss_sym;
+  RENDERENTRY *cache = NULL;
+  const RENDERENTRY *rendered = NULL;
+  size_t i = 0;
+
+  /*  Entries are written straight from the dictionary pools; only a
+  **  word with modifiers is rendered, through the render cache.  With
+  **  surface forms, every word is written straight from them.  The
+  **  dictionaries may hold entries longer than the maximum given for
+  **  this run.  */
+  if ((file_info -> mode == MODE_DECODE) && (surface_dict != NULL)) {
+    for (i = start; i < end; i++) {
+      wrd_key = GETSYMBOL (ss_sym, i);
+      nonwrd_key = GETSYMBOL (nws_sym, i);
       if (wrd_key != 0) {
-        LOOKUPFCODE (word_info -> dict_fc, wrd_key, wrd, wrd_len);
-        wrd_len = unstem (wrd, wrd_len, stem_mod);
-        uncasefold (wrd, wrd_len, casefold_mod);
-        uprintf (fp, wrd, wrd_len);
+        LOOKUPFCODE (surface_dict, wrd_key, item, wrd_len);
+        OUTBUFWRITE (out, item, wrd_len);
       }
       if (nonwrd_key != 0) {
-        LOOKUPFCODE (nonword_info -> dict_fc, nonwrd_key, nonwrd, nonwrd_len);
-        uprintf (fp, nonwrd, nonwrd_len);
+        LOOKUPFCODE (nonwrd_dict, nonwrd_key, nonwrd, nonwrd_len);
+        OUTBUFWRITE (out, nonwrd, nonwrd_len);
       }
     }
   }
+  else if (file_info -> mode == MODE_DECODE) {
+    cache = renderCacheInit ();
+    for (i = start; i < end; i++) {
+      wrd_key = GETSYMBOL (ws_sym, i);
+      casefold_mod = GETMODIFIER (cfm_mod, i);
+      stem_mod = GETMODIFIER (sm_mod, i);
+      nonwrd_key = GETSYMBOL (nws_sym, i);
+      if (wrd_key != 0) {
+        if ((stem_mod == 0) && (casefold_mod == 0)) {
+          LOOKUPFCODE (wrd_dict, wrd_key, item, wrd_len);
+          OUTBUFWRITE (out, item, wrd_len);
+        }
+        else {
+          rendered = renderCacheGet (cache, wrd_dict, word_info -> case_fc, wrd_key, casefold_mod, stem_mod);
+          OUTBUFWRITE (out, rendered -> text, rendered -> len);
+        }
+      }
+      if (nonwrd_key != 0) {
+        LOOKUPFCODE (nonwrd_dict, nonwrd_key, nonwrd, nonwrd_len);
+        OUTBUFWRITE (out, nonwrd, nonwrd_len);
+      }
+    }
+    wfree (cache);
+  }
   else if (file_info -> mode == MODE_DECODE_NONE) {
     /*  Forced-pairing not supported!!!  */
-    space[0] = ' ';
-    space_len = 1;
-    newline[0] = '\n';
-    newline_len = 1;
-    while (readFiles (file_info, &wrd_key, &casefold_mod, &stem_mod, &nonwrd_key) != 0) {
-      wrd_key = wrd_key & NO_TOP_BIT;
+    for (i = start; i < end; i++) {
+      wrd_key = GETSYMBOL (ws_sym, i);
+      casefold_mod = GETMODIFIER (cfm_mod, i);
+      stem_mod = GETMODIFIER (sm_mod, i);
+      nonwrd_key = GETSYMBOL (nws_sym, i);
       if (wrd_key != 0) {
-        LOOKUPFCODE (word_info -> dict_fc, wrd_key, wrd, wrd_len);
-        uprintf (fp, wrd, wrd_len);
+        LOOKUPFCODE (wrd_dict, wrd_key, item, wrd_len);
+        OUTBUFWRITE (out, item, wrd_len);
         /*  Add a newline after every closing tag.  */
-  if ((wrd_len > 2) && (wrd[0] == '<') && (wrd[1] == '/')) {
-          uprintf (fp, newline, newline_len);
+  if ((wrd_len > 2) && (item[0] == '<') && (item[1] == '/')) {
+          OUTBUFPUTC (out, '\n');
   }
   else {
-          uprintf (fp, space, space_len);
+          OUTBUFPUTC (out, ' ');
   }
       }
       if (nonwrd_key != 0) {
@@ -627,30 +1214,29 @@ void fileDecode (FILE_STRUCT *file_info, FILE *fp, WORD_STRUCT *word_info, NONWO
     }
   }
   else if (file_info -> mode == MODE_DECODE_LINK) {
-    space[0] = ' ';
-    space_len = 1;
-    newline[0] = '\n';
-    newline_len = 1;
-    while (readFiles (file_info, &wrd_key, &casefold_mod, &stem_mod, &nonwrd_key) != 0) {
-      wrd_key = wrd_key & NO_TOP_BIT;
+    for (i = start; i < end; i++) {
+      wrd_key = GETSYMBOL (ws_sym, i);
+      casefold_mod = GETMODIFIER (cfm_mod, i);
+      stem_mod = GETMODIFIER (sm_mod, i);
+      nonwrd_key = GETSYMBOL (nws_sym, i);
       if (wrd_key != 0) {
-        LOOKUPFCODE (word_info -> dict_fc, wrd_key, wrd, wrd_len);
-        uprintf (fp, wrd, wrd_len);
+        LOOKUPFCODE (wrd_dict, wrd_key, item, wrd_len);
+        OUTBUFWRITE (out, item, wrd_len);
       }
       if (nonwrd_key != 0) {
-        LOOKUPFCODE (nonword_info -> dict_fc, nonwrd_key, nonwrd, nonwrd_len);
+        LOOKUPFCODE (nonwrd_dict, nonwrd_key, nonwrd, nonwrd_len);
   /*  If the first non-word is a newline, add a newline; space
   **  otherwise.  */
         if (nonwrd[0] == '\n') {
-          uprintf (fp, newline, newline_len);
+          OUTBUFPUTC (out, '\n');
   }
   else {
-    uprintf (fp, space, space_len);
+    OUTBUFPUTC (out, ' ');
   }
       }
       else {
   /*  Ensure a space is added after every word token, at least.  */
-  uprintf (fp, space, space_len);
+  OUTBUFPUTC (out, ' ');
       }
     }
   }
@@ -659,12 +1245,155 @@ void fileDecode (FILE_STRUCT *file_info, FILE *fp, WORD_STRUCT *word_info, NONWO
     exit (EXIT_FAILURE);
   }
 
-  wfree (space);
-  wfree (newline);
-  wfree (nonwrd);
-  wfree (wrd);
+  return;
+}
+
+
+/*
+**  Decode count records, starting from record start, to fp.  The
+**  dictionaries must already have been loaded with fcodeDictDecode.
+**  The range is clipped to the length of the sequences.
+*/
+void fileDecodeRange (FILE_STRUCT *file_info, FILE *fp, WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info, size_t start, size_t count) {
+  OUT_BUF out;
+
+  if (start > file_info -> nsyms) {
+    start = file_info -> nsyms;
+  }
+  if (count > file_info -> nsyms - start) {
+    count = file_info -> nsyms - start;
+  }
+
+  if (count == file_info -> nsyms) {
+    adviseSequences (file_info, ACCESS_SEQUENTIAL);
+  }
+  initOutBuf (&out, fp);
+  decodeRecords (file_info, word_info, nonword_info, start, start + count, &out);
+  freeOutBuf (&out);
+  file_info -> bytes_out += out.written;
+
+  return;
+}
+
+
+void fileDecode (FILE_STRUCT *file_info, FILE *fp, WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info) {
+  fileDecodeRange (file_info, fp, word_info, nonword_info, 0, file_info -> nsyms);
 
   return;
 }
 
 
+/*  A range of records [start, end) decoded by one thread into the
+**  buffer out, which is in memory  */
+typedef struct decodejob {
+  FILE_STRUCT *file_info;
+  WORD_STRUCT *word_info;
+  NONWORD_STRUCT *nonword_info;
+  size_t start;
+  size_t end;
+  OUT_BUF out;
+} DECODEJOB;
+
+
+static void *decodeJob (void *arg) {
+  DECODEJOB *job = (DECODEJOB *) arg;
+
+  decodeRecords (job -> file_info, job -> word_info, job -> nonword_info, job -> start, job -> end, &job -> out);
+
+  return (NULL);
+}
+
+
+/*  Divide the next (at most) nthreads * MT_DECODE_RECORDS records,
+**  from *next up to end, evenly among the jobs and start a thread for
+**  each.  *next is moved past them.  Returns the number of jobs
+**  started.  */
+static unsigned int startDecodeJobs (DECODEJOB *jobs, pthread_t *threads, unsigned int nthreads, size_t *next, size_t end) {
+  size_t remaining = end - *next;
+  size_t per_job = 0;
+  size_t n = 0;
+  unsigned int njobs = 0;
+
+  if (remaining > (size_t) nthreads * MT_DECODE_RECORDS) {
+    remaining = (size_t) nthreads * MT_DECODE_RECORDS;
+  }
+  per_job = (remaining + nthreads - 1) / nthreads;
+
+  while (remaining != 0) {
+    n = (remaining < per_job) ? remaining : per_job;
+    jobs[njobs].start = *next;
+    jobs[njobs].end = *next + n;
+    *next += n;
+    remaining -= n;
+    if (pthread_create (&threads[njobs], NULL, decodeJob, &jobs[njobs]) != 0) {
+      fprintf (stderr, "Error creating decoding thread (%s, line %u).\n", __FILE__, __LINE__);
+      exit (EXIT_FAILURE);
+    }
+    njobs++;
+  }
+
+  return (njobs);
+}
+
+
+/*
+**  Decode count records, starting from record start, to fp with
+**  nthreads threads.  Each record depends only on its own four values
+**  and the dictionaries, which are only read, so the records are
+**  decoded in ranges, each by its own thread into its own buffer.  The
+**  buffers are then written out in order.  There are two sets of
+**  jobs, so that one set is decoded while the other is written.  The
+**  output is the same as that of fileDecodeRange.
+*/
+void fileDecodeThreaded (FILE_STRUCT *file_info, FILE *fp, WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info, size_t start, size_t count, unsigned int nthreads) {
+  DECODEJOB *jobs = NULL;
+  pthread_t *threads = NULL;
+  OUT_BUF out;
+  unsigned int njobs[2] = { 0, 0 };
+  unsigned int set = 0;
+  unsigned int i = 0;
+  size_t next = 0;
+
+  if (start > file_info -> nsyms) {
+    start = file_info -> nsyms;
+  }
+  if (count > file_info -> nsyms - start) {
+    count = file_info -> nsyms - start;
+  }
+
+  if (count == file_info -> nsyms) {
+    adviseSequences (file_info, ACCESS_SEQUENTIAL);
+  }
+  jobs = wmalloc (sizeof (DECODEJOB) * 2 * nthreads);
+  threads = wmalloc (sizeof (pthread_t) * 2 * nthreads);
+  for (i = 0; i < 2 * nthreads; i++) {
+    jobs[i].file_info = file_info;
+    jobs[i].word_info = word_info;
+    jobs[i].nonword_info = nonword_info;
+    initOutBufMem (&jobs[i].out);
+  }
+  initOutBuf (&out, fp);
+
+  next = start;
+  njobs[set] = startDecodeJobs (jobs, threads, nthreads, &next, start + count);
+  while (njobs[set] != 0) {
+    for (i = 0; i < njobs[set]; i++) {
+      (void) pthread_join (threads[set * nthreads + i], NULL);
+    }
+    njobs[set ^ 1] = startDecodeJobs (&jobs[(set ^ 1) * nthreads], &threads[(set ^ 1) * nthreads], nthreads, &next, start + count);
+    for (i = 0; i < njobs[set]; i++) {
+      copyOutBuf (&out, &jobs[set * nthreads + i].out);
+    }
+    set = set ^ 1;
+  }
+
+  freeOutBuf (&out);
+  file_info -> bytes_out += out.written;
+  for (i = 0; i < 2 * nthreads; i++) {
+    freeOutBuf (&jobs[i].out);
+  }
+  wfree (threads);
+  wfree (jobs);
+
+  return;
+}
@@ -9,21 +9,53 @@
 #define MIN_BUFF_SIZE (3 * word_info -> maxword)
 #define INIT_BUFF_SIZE 1048576
 
+/*  Most records decoded by each thread at a time when decoding with
+**  more than one thread  */
+#define MT_DECODE_RECORDS 1048576
+
+/*  Scratch space for parsing one (word, nonword) pair; every thread
+**  that parses text needs its own copy.  */
+typedef struct parsestruct {
+  unsigned char *wrd_buff;
+  unsigned int wrd_buff_len;
+  unsigned char *nonwrd_buff;
+  unsigned int nonwrd_buff_len;
+  unsigned int *m;                   /*  Measures used by the stemmer  */
+  bool notdone;                  /*  Previous token was left unfinished  */
+} PARSE_STRUCT;
+
 /*  Initialisation  */
-void initPrepair (WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info, unsigned int maxword, bool docasefold, bool dostem, bool printsorted);
+void initPrepair (WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info, unsigned int maxword, bool docasefold, bool dostem, bool printsorted, bool usehash);
+void freeLexicons (WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info);
 
-/*  Read from and write to sequences  */
+/*  Write to sequences  */
 void writeFiles (FILE_STRUCT *file_info, unsigned int wrd_key, unsigned int casefold_result, unsigned int stem_result, unsigned int nonwrd_key);
-unsigned int readFiles (FILE_STRUCT *file_info, unsigned int *wrd_key, unsigned int *casefold_result, unsigned int *stem_result, unsigned int *nonwrd_key);
 
 /*  Manage files  */
+void adviseMap (MAP_STRUCT *map, enum MAPACCESS access);
+void mapFile (unsigned char *name, MAP_STRUCT *map, enum MAPACCESS access);
+void unmapFile (MAP_STRUCT *map);
+bool hasPart (FILE_STRUCT *file_info, unsigned char *name);
+void mapPart (FILE_STRUCT *file_info, unsigned char *name, MAP_STRUCT *map, enum MAPACCESS access);
+void adviseSequences (FILE_STRUCT *file_info, enum MAPACCESS access);
 void openFiles (unsigned char *filename, FILE_STRUCT *file_info, const char *filemode, bool dicts_only);
+void remapSequence (unsigned int *p, size_t n, unsigned int *map);
 void seqReEncode (FILE_STRUCT *file_info, unsigned int *map, enum WORDTYPE type);
 void closeFilesEncode (FILE_STRUCT *file_info, unsigned int *word_map, unsigned int *nonword_map);
 void closeFilesDecode (FILE_STRUCT *file_info, WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info);
+void writeCasePatterns (FILE_STRUCT *file_info, WORD_STRUCT *word_info);
+FCODEDICT *loadCasePatterns (FILE_STRUCT *file_info);
+
+/*  Parsing  */
+void freeStemCache (WORD_STRUCT *word_info);
+void initParse (PARSE_STRUCT *parse, unsigned int maxword);
+void freeParse (PARSE_STRUCT *parse);
+void parseRecord (unsigned char **src_p, unsigned char *src_end, WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info, PARSE_STRUCT *parse, unsigned int *wrd_key, unsigned int *casefold_result, unsigned int *stem_result, unsigned int *nonwrd_key);
 
 /*  Main encoding/decoding functions  */
 void fileEncode (FILE_STRUCT *file_info, FILE *fp, WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info);
 void fileDecode (FILE_STRUCT *file_info, FILE *fp, WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info);
+void fileDecodeRange (FILE_STRUCT *file_info, FILE *fp, WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info, size_t start, size_t count);
+void fileDecodeThreaded (FILE_STRUCT *file_info, FILE *fp, WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info, size_t start, size_t count, unsigned int nthreads);
 
 #endif
@@ -0,0 +1,92 @@
+############################################################
+##  CMake script for the round-trip tests (see CMakeLists.txt)
+##
+##  Run with cmake -P and these variables set with -D:
+##    PREPAIR:        the prepair executable
+##    BENCH:          the prepair-bench executable
+##    WORK_DIR:       a directory of its own for the files of the test
+##    CORPUS_BYTES:   the size of the corpus generated by prepair-bench
+##                    (default: 400000)
+##    ENCODE_FLAGS:   the options used for encoding, besides -e and -i
+##    DECODE_FLAGS:   the options used for decoding, besides -d and -i
+##    SLICE:          if set, also decode the records SLICE at a time
+##                    with -r and check that the slices make up the
+##                    whole decoding
+##    MEMTEST:        if set, also run this program (memencode-test)
+##                    on the encoding and the corpus
+##    SAME_AS_FLAGS:  if set, also encode the corpus with these options
+##                    and check that every file is the same as with
+##                    ENCODE_FLAGS
+##
+##  The test fails unless decoding gives back the corpus exactly.
+##
+############################################################
+
+IF (NOT DEFINED CORPUS_BYTES)
+  SET (CORPUS_BYTES 400000)
+ENDIF (NOT DEFINED CORPUS_BYTES)
+SEPARATE_ARGUMENTS (ENCODE_FLAGS)
+SEPARATE_ARGUMENTS (DECODE_FLAGS)
+SEPARATE_ARGUMENTS (SAME_AS_FLAGS)
+
+FILE (REMOVE_RECURSE ${WORK_DIR})
+FILE (MAKE_DIRECTORY ${WORK_DIR})
+
+##  Run a command with its input and output in files, and stop if it fails
+MACRO (RUN_STEP INPUT OUTPUT)
+  EXECUTE_PROCESS (COMMAND ${ARGN} WORKING_DIRECTORY ${WORK_DIR} INPUT_FILE ${INPUT} OUTPUT_FILE ${OUTPUT} RESULT_VARIABLE _RESULT)
+  IF (NOT _RESULT EQUAL 0)
+    MESSAGE (FATAL_ERROR "Failed (${_RESULT}):  ${ARGN}")
+  ENDIF (NOT _RESULT EQUAL 0)
+ENDMACRO (RUN_STEP)
+
+##  Compare two files, and stop if they differ
+MACRO (SAME_FILES FIRST SECOND)
+  EXECUTE_PROCESS (COMMAND ${CMAKE_COMMAND} -E compare_files ${FIRST} ${SECOND} RESULT_VARIABLE _RESULT)
+  IF (NOT _RESULT EQUAL 0)
+    MESSAGE (FATAL_ERROR "${FIRST} and ${SECOND} differ")
+  ENDIF (NOT _RESULT EQUAL 0)
+ENDMACRO (SAME_FILES)
+
+SET (CORPUS ${WORK_DIR}/corpus.txt)
+SET (DECODED ${WORK_DIR}/decoded.txt)
+
+RUN_STEP (/dev/null ${CORPUS} ${BENCH} -g ${CORPUS_BYTES})
+RUN_STEP (${CORPUS} ${WORK_DIR}/encode.out ${PREPAIR} -e -i test ${ENCODE_FLAGS})
+
+##  The files of the other encoding must all be there and be the same
+IF (DEFINED SAME_AS_FLAGS)
+  RUN_STEP (${CORPUS} ${WORK_DIR}/other.out ${PREPAIR} -e -i other ${SAME_AS_FLAGS})
+  FOREACH (EXT wd ws nwd nws cfm sm cfx srf ss ppc)
+    IF (EXISTS ${WORK_DIR}/test.${EXT} OR EXISTS ${WORK_DIR}/other.${EXT})
+      SAME_FILES (${WORK_DIR}/test.${EXT} ${WORK_DIR}/other.${EXT})
+    ENDIF (EXISTS ${WORK_DIR}/test.${EXT} OR EXISTS ${WORK_DIR}/other.${EXT})
+  ENDFOREACH (EXT)
+ENDIF (DEFINED SAME_AS_FLAGS)
+
+IF (DEFINED MEMTEST)
+  RUN_STEP (/dev/null ${WORK_DIR}/memtest.out ${MEMTEST} test ${CORPUS})
+ENDIF (DEFINED MEMTEST)
+
+RUN_STEP (/dev/null ${DECODED} ${PREPAIR} -d -i test ${DECODE_FLAGS})
+SAME_FILES (${CORPUS} ${DECODED})
+
+##  Decode the slices in turn until one is empty, and put them together
+IF (DEFINED SLICE)
+  SET (SLICES ${WORK_DIR}/slices.txt)
+  SET (PIECE ${WORK_DIR}/slice.txt)
+  FILE (WRITE ${SLICES} "")
+  SET (START 0)
+  WHILE (1)
+    RUN_STEP (/dev/null ${PIECE} ${PREPAIR} -d -i test ${DECODE_FLAGS} -r ${START}:${SLICE})
+    FILE (READ ${PIECE} _TEXT)
+    IF ("${_TEXT}" STREQUAL "")
+      BREAK ()
+    ENDIF ("${_TEXT}" STREQUAL "")
+    FILE (APPEND ${SLICES} "${_TEXT}")
+    MATH (EXPR START "${START} + ${SLICE}")
+  ENDWHILE (1)
+  SAME_FILES (${DECODED} ${SLICES})
+ENDIF (DEFINED SLICE)
+
+FILE (REMOVE_RECURSE ${WORK_DIR})
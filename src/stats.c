@@ -0,0 +1,296 @@
+/*
+   Statistics of a run, written as JSON with --stats-json.
+
+   The phases of a run are timed with both a monotonic clock and the
+   CPU clock of the process, so that the CPU time of a multithreaded
+   phase covers all of its threads.  The phases of parsing a record
+   are only sampled (see parseRecord); their times are estimated from
+   the sampled records and marked as such.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include "common-def.h"
+#include "wmalloc.h"
+#include "prepair-defn.h"
+#include "fcode.h"
+#include "word.h"
+#include "nonword.h"
+#include "prepair.h"
+#include "container.h"
+#include "stats.h"
+
+#include "PrePairConfig.h"
+
+/*  Names of the phases in the JSON output  */
+static const char *phase_names[NUM_STATS_PHASES] = { "encode", "dictionary_sort_write", "sequence_remap", "surface_forms", "container_pack", "dictionary_load", "decode_output" };
+static const char *parse_phase_names[NUM_PARSE_PHASES] = { "tokenize", "normalize", "lexicon_insert" };
+
+/*  Extensions of the files of a run, in the order they are listed  */
+#define NUM_STREAMS 10
+static const char *stream_names[NUM_STREAMS] = { "wd", "ws", "nwd", "nws", "cfm", "cfx", "sm", "srf", "ss", "ppc" };
+
+/*  Number of clock readings used to measure their cost  */
+#define CLOCK_CALIBRATE_READS 10000
+
+
+static unsigned long long readClock (clockid_t clock) {
+  struct timespec ts;
+
+  if (clock_gettime (clock, &ts) != 0) {
+    fprintf (stderr, "Error reading the clock (%s, line %u).\n", __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+
+  return ((unsigned long long) ts.tv_sec * 1000000000ULL + (unsigned long long) ts.tv_nsec);
+}
+
+
+/*  The average cost of reading the monotonic clock, in nanoseconds.
+**  Every time sampled by parseRecord includes about one reading.  */
+static double clockOverhead (void) {
+  unsigned long long start = 0;
+  unsigned int i = 0;
+
+  start = readClock (CLOCK_MONOTONIC);
+  for (i = 0; i < CLOCK_CALIBRATE_READS; i++) {
+    (void) readClock (CLOCK_MONOTONIC);
+  }
+
+  return ((double) (readClock (CLOCK_MONOTONIC) - start) / (double) (CLOCK_CALIBRATE_READS + 1));
+}
+
+
+/*  The monotonic clock, in nanoseconds  */
+unsigned long long statsClock (void) {
+  return (readClock (CLOCK_MONOTONIC));
+}
+
+
+void statsInit (STATS_STRUCT *stats) {
+  unsigned int i = 0;
+
+  for (i = 0; i < NUM_STATS_PHASES; i++) {
+    stats -> wall_ns[i] = 0;
+    stats -> cpu_ns[i] = 0;
+    stats -> timed[i] = false;
+  }
+  stats -> start_wall = 0;
+  stats -> start_cpu = 0;
+
+  return;
+}
+
+
+void statsStart (STATS_STRUCT *stats) {
+  stats -> start_wall = readClock (CLOCK_MONOTONIC);
+  stats -> start_cpu = readClock (CLOCK_PROCESS_CPUTIME_ID);
+
+  return;
+}
+
+
+/*  Charge the time since statsStart to phase  */
+void statsStop (STATS_STRUCT *stats, enum STATSPHASE phase) {
+  stats -> wall_ns[phase] += readClock (CLOCK_MONOTONIC) - stats -> start_wall;
+  stats -> cpu_ns[phase] += readClock (CLOCK_PROCESS_CPUTIME_ID) - stats -> start_cpu;
+  stats -> timed[phase] = true;
+
+  return;
+}
+
+
+/*  Write the string s as a JSON string  */
+static void writeJsonString (FILE *fp, const unsigned char *s) {
+  fputc ('"', fp);
+  for (; *s != '\0'; s++) {
+    if ((*s == '"') || (*s == '\\')) {
+      fprintf (fp, "\\%c", *s);
+    }
+    else if (*s < 0x20) {
+      fprintf (fp, "\\u%04x", *s);
+    }
+    else {
+      fputc (*s, fp);
+    }
+  }
+  fputc ('"', fp);
+
+  return;
+}
+
+
+/*  Write the size of each file of the run as the members of a JSON
+**  object.  Missing files are given a size of null.  With sections,
+**  the files packed in the container are given the sizes of their
+**  sections instead.  */
+static void writeStreamSizes (FILE *fp, const unsigned char *filename, bool sections) {
+  size_t len = strlen ((const char*) filename);
+  char *name = wmalloc (sizeof (char) * (len + 5));
+  struct stat st;
+  MAP_STRUCT container;
+  MAP_STRUCT section;
+  unsigned int i = 0;
+
+  if (sections == true) {
+    (void) snprintf (name, len + 5, "%s.ppc", (const char*) filename);
+    mapFile ((unsigned char*) name, &container, ACCESS_NORMAL);
+    containerCheck (&container, (unsigned char*) name);
+  }
+  for (i = 0; i < NUM_STREAMS; i++) {
+    (void) snprintf (name, len + 5, "%s.%s", (const char*) filename, stream_names[i]);
+    if ((sections == true) && (strcmp (stream_names[i], "ppc") != 0)) {
+      if (containerSection (&container, stream_names[i], &section) == true) {
+        fprintf (fp, "      \"%s\": %llu%s\n", stream_names[i], (unsigned long long) section.len, (i + 1 < NUM_STREAMS) ? "," : "");
+        unmapFile (&section);
+      }
+      else {
+        fprintf (fp, "      \"%s\": null%s\n", stream_names[i], (i + 1 < NUM_STREAMS) ? "," : "");
+      }
+    }
+    else if (stat (name, &st) == 0) {
+      fprintf (fp, "      \"%s\": %llu%s\n", stream_names[i], (unsigned long long) st.st_size, (i + 1 < NUM_STREAMS) ? "," : "");
+    }
+    else {
+      fprintf (fp, "      \"%s\": null%s\n", stream_names[i], (i + 1 < NUM_STREAMS) ? "," : "");
+    }
+  }
+  if (sections == true) {
+    unmapFile (&container);
+  }
+  wfree (name);
+
+  return;
+}
+
+
+/*
+**  Write the statistics of the run to the file name.  The files of
+**  the run (filename with each extension) must have been closed.
+*/
+void statsWriteJson (const char *name, const STATS_STRUCT *stats, const unsigned char *filename, FILE_STRUCT *file_info, WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info, unsigned int nthreads) {
+  FILE *fp = NULL;
+  struct rusage usage;
+  bool encoding = (file_info -> mode == MODE_ENCODE) ? true : false;
+  double estimate = 0.0;
+  double overhead = 0.0;
+  const char *sep = "";
+  unsigned int i = 0;
+
+  FOPEN (name, fp, "w");
+
+  fprintf (fp, "{\n");
+  fprintf (fp, "  \"version\": \"%u.%u\",\n", PrePair_VERSION_MAJOR, PrePair_VERSION_MINOR);
+  fprintf (fp, "  \"mode\": \"%s\",\n", encoding ? "encode" : "decode");
+  fprintf (fp, "  \"files\": ");
+  writeJsonString (fp, filename);
+  fprintf (fp, ",\n");
+  fprintf (fp, "  \"threads\": %u,\n", nthreads);
+
+  fprintf (fp, "  \"phases\": {\n");
+  /*  Each sampled phase, less the cost of reading the clock, is
+  **  scaled up from the sampled records to all of them.  The samples
+  **  add up the time of every parsing thread, so that estimate is CPU
+  **  time; the wall time assumes the threads were kept equally busy.  */
+  if ((encoding == true) && (word_info -> sampled != 0)) {
+    overhead = clockOverhead ();
+    for (i = 0; i < NUM_PARSE_PHASES; i++) {
+      estimate = (double) word_info -> sample_ns[i] - overhead * (double) word_info -> sample_marks[i];
+      if (estimate < 0.0) {
+        estimate = 0.0;
+      }
+      estimate = estimate / (double) word_info -> sampled * (double) word_info -> total_tokens / 1e9;
+      fprintf (fp, "%s    \"%s\": { \"wall_s\": %.6f, \"cpu_s\": %.6f, \"estimated\": true }", sep, parse_phase_names[i], estimate / (double) nthreads, estimate);
+      sep = ",\n";
+    }
+  }
+  for (i = 0; i < NUM_STATS_PHASES; i++) {
+    if (stats -> timed[i] == true) {
+      fprintf (fp, "%s    \"%s\": { \"wall_s\": %.6f, \"cpu_s\": %.6f }", sep, phase_names[i], (double) stats -> wall_ns[i] / 1e9, (double) stats -> cpu_ns[i] / 1e9);
+      sep = ",\n";
+    }
+  }
+  fprintf (fp, "\n  },\n");
+
+  /*  How the estimated phases were sampled  */
+  fprintf (fp, "  \"sampling\": {\n");
+  fprintf (fp, "    \"sampled_records\": %llu,\n", word_info -> sampled);
+  fprintf (fp, "    \"sample_rate\": %u\n", PHASE_SAMPLE_RATE);
+  fprintf (fp, "  },\n");
+
+  fprintf (fp, "  \"bytes\": {\n");
+  if (encoding == true) {
+    fprintf (fp, "    \"read\": { \"text\": %llu },\n", file_info -> bytes_in);
+    fprintf (fp, "    \"written\": {\n");
+    writeStreamSizes (fp, filename, false);
+    fprintf (fp, "    }\n");
+  }
+  else {
+    /*  Only the records in a range (-r) are read from the sequences,
+    **  so these are the sizes of the files (or the sections of the
+    **  container) decoded from, not the bytes read  */
+    fprintf (fp, "    \"stream_sizes\": {\n");
+    writeStreamSizes (fp, filename, file_info -> in_container);
+    fprintf (fp, "    },\n");
+    fprintf (fp, "    \"written\": { \"text\": %llu }\n", file_info -> bytes_out);
+  }
+  fprintf (fp, "  },\n");
+
+  fprintf (fp, "  \"memory\": {\n");
+  if (getrusage (RUSAGE_SELF, &usage) == 0) {
+    /*  ru_maxrss is in kilobytes on Linux  */
+    fprintf (fp, "    \"peak_rss_bytes\": %llu,\n", (unsigned long long) usage.ru_maxrss * 1024ULL);
+  }
+  else {
+    fprintf (fp, "    \"peak_rss_bytes\": null,\n");
+  }
+#ifdef COUNT_MALLOC
+  fprintf (fp, "    \"wmalloc_peak_bytes\": %llu\n", (unsigned long long) peakWMalloc ());
+#else
+  /*  Allocations are only counted with COUNT_MALLOC  */
+  fprintf (fp, "    \"wmalloc_peak_bytes\": null\n");
+#endif
+  fprintf (fp, "  },\n");
+
+  fprintf (fp, "  \"counters\": {\n");
+  fprintf (fp, "    \"records\": %llu,\n", encoding ? word_info -> total_tokens : (unsigned long long) file_info -> nsyms);
+  fprintf (fp, "    \"words\": {\n");
+  fprintf (fp, "      \"unique\": %u,\n", word_info -> nwords);
+  fprintf (fp, "      \"tokens\": %llu,\n", word_info -> total_tokens);
+  fprintf (fp, "      \"total_length\": %llu,\n", word_info -> total_length);
+  fprintf (fp, "      \"lexicon_length\": %llu,\n", word_info -> total_words_len);
+  fprintf (fp, "      \"long_tokens\": %llu,\n", word_info -> long_tokens);
+  fprintf (fp, "      \"broken_by_tags\": %llu,\n", word_info -> enforce_tags);
+  fprintf (fp, "      \"zero_length\": %llu,\n", word_info -> zerolength_sym);
+  fprintf (fp, "      \"stem_cache_hits\": %llu,\n", word_info -> cache_hits);
+  fprintf (fp, "      \"stem_cache_comparisons\": %llu,\n", word_info -> cache_cmps);
+  fprintf (fp, "      \"comparisons\": %llu\n", word_info -> cmps);
+  fprintf (fp, "    },\n");
+  fprintf (fp, "    \"nonwords\": {\n");
+  fprintf (fp, "      \"unique\": %u,\n", nonword_info -> nnonwords);
+  fprintf (fp, "      \"tokens\": %llu,\n", nonword_info -> total_tokens);
+  fprintf (fp, "      \"total_length\": %llu,\n", nonword_info -> total_length);
+  fprintf (fp, "      \"lexicon_length\": %llu,\n", nonword_info -> total_nonwords_len);
+  fprintf (fp, "      \"long_tokens\": %llu,\n", nonword_info -> long_tokens);
+  fprintf (fp, "      \"broken_by_tags\": %llu,\n", nonword_info -> enforce_tags);
+  fprintf (fp, "      \"zero_length\": %llu,\n", nonword_info -> zerolength_sym);
+  fprintf (fp, "      \"comparisons\": %llu\n", nonword_info -> cmps);
+  fprintf (fp, "    }\n");
+  fprintf (fp, "  }\n");
+  fprintf (fp, "}\n");
+
+  if (fclose (fp) != 0) {
+    fprintf (stderr, "Error writing %s (%s, line %u).\n", name, __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+
+  return;
+}
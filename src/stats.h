@@ -0,0 +1,28 @@
+#ifndef STATS_H
+#define STATS_H
+
+/*  Phases of a run which are timed as a whole, with statsStart and
+**  statsStop around them.  The phases of parsing (tokenising,
+**  normalising and inserting into the lexicons) are too short to be
+**  timed this way; parseRecord samples them instead (see
+**  PHASE_SAMPLE_RATE).  */
+enum STATSPHASE { STATS_ENCODE = 0, STATS_DICT_WRITE = 1, STATS_SEQ_REMAP = 2, STATS_SURFACE = 3, STATS_CONTAINER = 4, STATS_DICT_LOAD = 5, STATS_DECODE = 6, NUM_STATS_PHASES = 7 };
+
+/*  Time spent in each phase, in nanoseconds, both on the wall clock
+**  and on the CPU (summed over all threads of the process).  A phase
+**  may be timed more than once; its times are added up.  */
+typedef struct statsstruct {
+  unsigned long long wall_ns[NUM_STATS_PHASES];
+  unsigned long long cpu_ns[NUM_STATS_PHASES];
+  bool timed[NUM_STATS_PHASES];
+  unsigned long long start_wall;     /*  When the current phase began  */
+  unsigned long long start_cpu;
+} STATS_STRUCT;
+
+unsigned long long statsClock (void);
+void statsInit (STATS_STRUCT *stats);
+void statsStart (STATS_STRUCT *stats);
+void statsStop (STATS_STRUCT *stats, enum STATSPHASE phase);
+void statsWriteJson (const char *name, const STATS_STRUCT *stats, const unsigned char *filename, FILE_STRUCT *file_info, WORD_STRUCT *word_info, NONWORD_STRUCT *nonword_info, unsigned int nthreads);
+
+#endif
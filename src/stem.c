@@ -69,8 +69,9 @@
 #include "common-def.h"
 #include "ustring.h"
 #include "stem.h"
+#include "stemtables.h"
 
-static unsigned int *findM (unsigned char *wrd, unsigned int len, unsigned int *m_array);
+static void updateM (unsigned char *wrd, unsigned int from, unsigned int len, unsigned int *m_array);
 
 static unsigned int step1a (unsigned char *wrd, unsigned int *len, unsigned int *m);
 static unsigned int step1b (unsigned char *wrd, unsigned int *len, unsigned int *m);
@@ -96,22 +97,50 @@ static unsigned int packModifier (enum S_STEM1a result1a, enum S_STEM1b result1b
 static void unpackModifier (unsigned int modifier, enum S_STEM1a *result1a, enum S_STEM1b *result1b, enum S_STEM1c *result1c, enum S_STEM1d *result1d, enum S_STEM2 *result2, enum S_STEM3 *result3, enum S_STEM4 *result4, enum S_STEM5a *result5a, enum S_STEM5b *result5b);
 
 
-static unsigned int *findM (unsigned char *wrd, unsigned int len, unsigned int *m_array) {
-  unsigned int i = 0;
+const unsigned char stem_aeiou[256] = {
+  ['a'] = 1, ['e'] = 1, ['i'] = 1, ['o'] = 1, ['u'] = 1
+};
+
+
+/*
+**  Compute the measure of positions from to len - 1 of the word, where
+**  m_array[i] is the number of vowel-consonant sequences in wrd[0..i].
+**  The measure of a position depends only on the letters up to it, so
+**  the entries before from are left as they are.  A 'y' is a vowel
+**  unless it starts the word or follows a, e, i, o or u, so each
+**  position is classified without branches from two table lookups.
+*/
+static void updateM (unsigned char *wrd, unsigned int from, unsigned int len, unsigned int *m_array) {
+  unsigned int i = from;
   unsigned int m = 0;
-  enum CV status = UNKNOWN;
-  enum CV prev_status = UNKNOWN;
+  unsigned int aeiou = 0;
+  unsigned int prev_aeiou = 0;
+  unsigned int vowel = 0;
+  unsigned int prev_vowel = 0;
+
+  if (i != 0) {
+    m = m_array[i - 1];
+    prev_aeiou = stem_aeiou[wrd[i - 1]];
+    prev_vowel = (CLASSIFYCHAR (wrd, i - 1) == VOWEL) ? 1U : 0U;
+  }
+  else if (len != 0) {
+    /*  The first letter is a vowel only if it is one of a, e, i, o or u  */
+    prev_aeiou = stem_aeiou[wrd[0]];
+    prev_vowel = prev_aeiou;
+    m_array[0] = 0;
+    i = 1;
+  }
 
-  for (i = 0; i < len; i++) {
-    status = CLASSIFYCHAR (wrd, i);
-    if ((prev_status == VOWEL) && (status == CONSONANT)) {
-      m++;
-    }
-    prev_status = status;
+  for (; i < len; i++) {
+    aeiou = stem_aeiou[wrd[i]];
+    vowel = aeiou | ((unsigned int) (wrd[i] == (unsigned char) 'y') & (prev_aeiou ^ 1U));
+    m += prev_vowel & (vowel ^ 1U);
     m_array[i] = m;
+    prev_aeiou = aeiou;
+    prev_vowel = vowel;
   }
 
-  return (m_array);
+  return;
 }
 
 
@@ -161,7 +190,6 @@ static unsigned int step1c (unsigned char *wrd, unsigned int *len, unsigned int
       if (CLASSIFYCHAR (wrd, i) == VOWEL) {
         (*len) -= 2;
         result = ED_1c;
-        m = findM (wrd, *len, m);
         break;
       }
     }
@@ -172,7 +200,6 @@ static unsigned int step1c (unsigned char *wrd, unsigned int *len, unsigned int
       if (CLASSIFYCHAR (wrd, i) == VOWEL) {
         (*len) -= 3;
         result = ING_1c;
-        m = findM (wrd, *len, m);
         break;
       }
     }
@@ -185,14 +212,13 @@ static unsigned int step1c (unsigned char *wrd, unsigned int *len, unsigned int
       wrd[*len] = (unsigned char) 'e';
       (*len)++;
       result++;
-      m = findM (wrd, *len, m);
+      updateM (wrd, (*len) - 1, *len, m);
       return (result);
     }
 
     if ((*len > 2) && (wrd[(*len) - 1] == wrd[(*len) - 2]) && (CLASSIFYCHAR (wrd, (*len) - 1) == CONSONANT) && ((wrd[(*len) - 1] != (unsigned char) 'l') && (wrd[(*len) - 1] != (unsigned char) 's') && (wrd[(*len) - 1] != (unsigned char) 'z'))) {
       (*len)--;
       result = result + 2;
-      m = findM (wrd, *len, m);
       return (result);
     }
 
@@ -210,12 +236,12 @@ static unsigned int step1c (unsigned char *wrd, unsigned int *len, unsigned int
           wrd[*len] = (unsigned char) 'e';
           (*len)++;
           result++;
-         }
+          updateM (wrd, (*len) - 1, *len, m);
+        }
       }
     }
   }
 
-  m = findM (wrd, *len, m);
   return (result);
 }
 
@@ -238,87 +264,70 @@ static unsigned int step1d (unsigned char *wrd, unsigned int *len, unsigned int
 }
 
 
-static unsigned int step2 (unsigned char *wrd, unsigned int *len, unsigned int *m) {
-  enum S_STEM2 result = NONE_2;
-  bool match_result = false;
+/*
+**  Apply the first rule (in the order of stemrules.h) whose suffix
+**  ends the word, by walking the trie of reversed suffixes backwards
+**  from the end of the word.  As with CHOP_M, the suffix must be
+**  shorter than the word, and no other rule is tried once one has
+**  matched, even if the measure prevents it from applying.
+*/
+static unsigned int applyRules (const STEMRULE *rules, const STEMTRIENODE *nodes, const STEMTRIEEDGE *edges, unsigned char *wrd, unsigned int *len, unsigned int *m) {
+  const STEMRULE *r = NULL;
+  unsigned int node = 0;
+  unsigned int best = STEM_NORULE;
+  unsigned int i = 0;
+  unsigned int e = 0;
+  unsigned int end = 0;
+  unsigned char c;
+
+  for (i = 1; i < *len; i++) {
+    c = wrd[(*len) - i];
+    e = nodes[node].edge;
+    end = e + nodes[node].nedges;
+    while ((e < end) && (edges[e].c != c)) {
+      e++;
+    }
+    if (e == end) {
+      break;
+    }
+    node = edges[e].child;
+    if (nodes[node].rule < best) {
+      r = &rules[nodes[node].rule];
+      if ((r -> st == 0) || (((*len) > r -> suflen + 1) && ((wrd[(*len) - r -> suflen - 1] == (unsigned char) 's') || (wrd[(*len) - r -> suflen - 1] == (unsigned char) 't')))) {
+        best = nodes[node].rule;
+      }
+    }
+  }
 
-  MOD_CHOP_M (wrd, *len, "ational", 7, 5, "e", 1, IONAL_E_2, m, 0);
-  CHOP_M (wrd, *len, "tional", 6, 2, AL_2, m, 0);
-  MOD_CHOP_M (wrd, *len, "enci", 4, 1, "e", 1, I_E_2, m, 0);
-  MOD_CHOP_M (wrd, *len, "anci", 4, 1, "e", 1, I_E_2, m, 0);
-  CHOP_M (wrd, *len, EN_IZER, 4, 1, R_2, m, 0);
-  /*  Next one modified from the one in the original paper -- mentioned
-  **  on Porter's web site.  */
-  MOD_CHOP_M (wrd, *len, "bli", 3, 1, "e", 1, I_E_2, m, 0);
-  /*  MOD_CHOP_M (wrd, *len, "abli", 4, 1, "e", 1, I_E_2, m, 0);*/
-  CHOP_M (wrd, *len, "alli", 4, 2, LI_2, m, 0);
-  CHOP_M (wrd, *len, "entli", 5, 2, LI_2, m, 0);
-  CHOP_M (wrd, *len, "eli", 3, 2, LI_2, m, 0);
-  CHOP_M (wrd, *len, "ousli", 5, 2, LI_2, m, 0);
-  MOD_CHOP_M (wrd, *len, EN_IZATION, 7, 5, "e", 1, IZATION_IZE_2, m, 0);
-  MOD_CHOP_M (wrd, *len, "ation", 5, 3, "e", 1, ATION_ATE_2, m, 0);
-  MOD_CHOP_M (wrd, *len, "ator", 4, 2, "e", 1, ATOR_ATE_2, m, 0);
-  CHOP_M (wrd, *len, "alism", 5, 3, ISM_2, m, 0);
-  CHOP_M (wrd, *len, "iveness", 7, 4, NESS_2, m, 0);
-  CHOP_M (wrd, *len, "fulness", 7, 4, NESS_2, m, 0);
-  CHOP_M (wrd, *len, "ousness", 7, 4, NESS_2, m, 0);
-  CHOP_M (wrd, *len, "aliti", 5, 3, ITI_2, m, 0);
-  MOD_CHOP_M (wrd, *len, "iviti", 5, 3, "e", 1, ITI_E_2, m, 0);
-  MOD_CHOP_M (wrd, *len, "biliti", 6, 5, "le", 2, BILITI_BLE_2, m, 0);
-  /*  Next one is new, but mentioned on Porter's web site  */
-  CHOP_M (wrd, *len, "logi", 4, 1, I_2, m, 0);
+  if (best == STEM_NORULE) {
+    return (0);
+  }
 
-  return (result);
+  r = &rules[best];
+  if (m[(*len) - r -> suflen - 1] > r -> mval) {
+    (*len) -= r -> cutlen;
+    memcpy (wrd + (*len), r -> newsuf, r -> newsuflen);
+    (*len) += r -> newsuflen;
+    updateM (wrd, (*len) - r -> newsuflen, *len, m);
+    return (r -> result);
+  }
+
+  return (0);
 }
 
 
-static unsigned int step3 (unsigned char *wrd, unsigned int *len, unsigned int *m) {
-  enum S_STEM3 result = NONE_3;
-  bool match_result = false;
+static unsigned int step2 (unsigned char *wrd, unsigned int *len, unsigned int *m) {
+  return (applyRules (step2_rules, step2_nodes, step2_edges, wrd, len, m));
+}
 
-  /*  Step 3  */
-  CHOP_M (wrd, *len, "icate", 5, 3, ATE_3, m, 0);
-  CHOP_M (wrd, *len, "ative", 5, 5, ATIVE_3, m, 0);
-  CHOP_M (wrd, *len, EN_ALIZE, 5, 3, IZE_3, m, 0);
-  CHOP_M (wrd, *len, "iciti", 5, 3, ITI_3, m, 0);
-  CHOP_M (wrd, *len, "ical", 4, 2, AL_3, m, 0);
-  CHOP_M (wrd, *len, "ful", 3, 3, FUL_3, m, 0);
-  CHOP_M (wrd, *len, "ness", 4, 4, NESS_3, m, 0);
 
-  return (result);
+static unsigned int step3 (unsigned char *wrd, unsigned int *len, unsigned int *m) {
+  return (applyRules (step3_rules, step3_nodes, step3_edges, wrd, len, m));
 }
 
 
 static unsigned int step4 (unsigned char *wrd, unsigned int *len, unsigned int *m) {
-  enum S_STEM4 result = NONE_4;
-  bool match_result = false;
-
-  /*  Step 4  */
-  CHOP_M (wrd, *len, "al", 2, 2, AL_4, m, 1);
-  CHOP_M (wrd, *len, "ance", 4, 4, ANCE_4, m, 1);
-  CHOP_M (wrd, *len, "ence", 4, 4, ENCE_4, m, 1);
-  CHOP_M (wrd, *len, "er", 2, 2, ER_4, m, 1);
-  CHOP_M (wrd, *len, "ic", 2, 2, IC_4, m, 1);
-  CHOP_M (wrd, *len, "able", 4, 4, ABLE_4, m, 1);
-  CHOP_M (wrd, *len, "ible", 4, 4, IBLE_4, m, 1);
-  CHOP_M (wrd, *len, "ant", 3, 3, ANT_4, m, 1);
-  CHOP_M (wrd, *len, "ement", 5, 5, EMENT_4, m, 1);
-  CHOP_M (wrd, *len, "ment", 4, 4, MENT_4, m, 1);
-  CHOP_M (wrd, *len, "ent", 3, 3, ENT_4, m, 1);
-
-  if ((*len > 4) && ((wrd[(*len) - 4] == (unsigned char) 's') || (wrd[(*len) - 4] == (unsigned char) 't'))) {
-    CHOP_M (wrd, *len, "ion", 3, 3, ION_4, m, 1);
-  }
-
-  CHOP_M (wrd, *len, "ou", 2, 2, OU_4, m, 1);
-  CHOP_M (wrd, *len, "ism", 3, 3, ISM_4, m, 1);
-  CHOP_M (wrd, *len, "ate", 3, 3, ATE_4, m, 1);
-  CHOP_M (wrd, *len, "iti", 3, 3, ITI_4, m, 1);
-  CHOP_M (wrd, *len, "ous", 3, 3, OUS_4, m, 1);
-  CHOP_M (wrd, *len, "ive", 3, 3, IVE_4, m, 1);
-  CHOP_M (wrd, *len, EN_IZE, 3, 3, IZE_4, m, 1);
-
-  return (result);
+  return (applyRules (step4_rules, step4_nodes, step4_edges, wrd, len, m));
 }
 
 
@@ -508,17 +517,13 @@ unsigned int stem (unsigned char *wrd, unsigned int *wrd_len, unsigned int *m) {
   enum S_STEM5a result5a = NONE_5a;
   enum S_STEM5b result5b = NONE_5b;
 
-  if (len > 16) {
-    fprintf (stderr, "Original length greater: %u\n", len);
-    exit (EXIT_FAILURE);
-  }
-  /*  Do not bother stemming words if they are 3 characters or shorter
-  **  or are a tag.  */
-  if ((len <= 3) || (wrd[len - 1] == (unsigned char) '>')) {
+  /*  Do not bother stemming words if they are 3 characters or shorter,
+  **  longer than MAXSTEMLEN, or are a tag.  */
+  if ((len <= 3) || (len > MAXSTEMLEN) || (wrd[len - 1] == (unsigned char) '>')) {
     return (0);
   }
 
-  m = findM (wrd, len, m);
+  updateM (wrd, 0, len, m);
   result1a = step1a (wrd, &len, m);
   result1b = step1b (wrd, &len, m);
   result1c = step1c (wrd, &len, m);
@@ -1,7 +1,8 @@
 #ifndef STEM_H
 #define STEM_H
 
-#define MAXSTEMLEN 32
+/*  Longer words are left unstemmed  */
+#define MAXSTEMLEN 256
 
 enum CV { UNKNOWN = 0, CONSONANT = 1, VOWEL = 2 };
 
@@ -38,14 +39,16 @@ enum S_STEM5b { NONE_5b = 0, DOUBLE_5b = 1 };
 #endif
 
 
+/*  Non-zero for the letters a, e, i, o and u (see stem.c)  */
+extern const unsigned char stem_aeiou[256];
+
+#define ISAEIOU(C) (stem_aeiou[(unsigned char) (C)] != 0)
+
+/*  A letter is a vowel if it is one of a, e, i, o or u, or a 'y'
+**  that does not start the word or follow one of them  */
 #define CLASSIFYCHAR(STR,POS)                                      \
-((STR[POS] == (unsigned char) 'a' || STR[POS] == (unsigned char) 'e' ||        \
-STR[POS] == (unsigned char) 'i' || STR[POS] == (unsigned char) 'o' ||          \
-STR[POS] == (unsigned char) 'u' || ((POS != 0) && (STR[POS] ==           \
-(unsigned char) 'y') && (STR[POS - 1] != (unsigned char) 'a') && (STR[POS - 1] \
-!= (unsigned char) 'e') && (STR[POS - 1] != (unsigned char) 'i') &&            \
-(STR[POS - 1] != (unsigned char) 'o') && (STR[POS - 1] !=                \
-(unsigned char) 'u'))) ? VOWEL : CONSONANT)
+((ISAEIOU (STR[POS]) || ((POS != 0) && (STR[POS] == (unsigned char) 'y') && \
+!ISAEIOU (STR[(POS) - 1]))) ? VOWEL : CONSONANT)
 
 
 /*  Check if STR, of length LEN, is longer than SUFLEN, the length of the 
@@ -62,7 +65,9 @@ STR[POS] == (unsigned char) 'u' || ((POS != 0) && (STR[POS] ==           \
 **    M (unsigned int*)
 **    MVAL (unsigned int)
 ** 
-**  The M array needs to be updated after any change.   CHOP does the 
+**  The measure of a position depends only on the letters up to it,
+**  so M stays valid after a suffix is cut and only the positions of
+**  NEWSUF need to be recomputed after a change.  CHOP does the 
 **  same, but without checking M.  MOD_CHOP_M is used for cases when
 **  cutting a suffix alone is not sufficient and a change in the 
 **  string is required.  In this case, NEWSUF of length NEWSUFLEN is
@@ -76,7 +81,6 @@ if ((match_result == false) && ((LEN) > SUFLEN)) {         \
     if (M[(LEN)-SUFLEN-1] > MVAL) {                          \
       (LEN) -= CUTLEN;                                       \
       result = FLAG;                                         \
-      M = findM (STR, LEN, M);                               \
     }                                                        \
     return (result);                                         \
   }                                                          \
@@ -90,7 +94,6 @@ if ((match_result == false) && ((LEN) > SUFLEN)) {         \
     if (M[(LEN)-SUFLEN-1] > MVAL) {                          \
       (LEN) -= CUTLEN;                                       \
       result = FLAG;                                         \
-      M = findM (STR, LEN, M);                               \
     }                                                        \
   }                                                          \
 }
@@ -104,8 +107,8 @@ if ((match_result == false) && ((LEN) > SUFLEN)) {         \
       (LEN) -= CUTLEN;                                       \
       memcpy (STR+(LEN),NEWSUF,NEWSUFLEN);                   \
       (LEN) += NEWSUFLEN;                                    \
+      updateM (STR, (LEN) - NEWSUFLEN, LEN, M);              \
       result = FLAG;                                         \
-      M = findM (STR, LEN, M);                               \
     }                                                        \
     return (result);                                         \
   }                                                          \
@@ -118,7 +121,6 @@ if ((match_result == false) && ((LEN) > SUFLEN)) {         \
     match_result = true;                                   \
     (LEN) -= CUTLEN;                                         \
     result = FLAG;                                           \
-    M = findM (STR, LEN, M);                                 \
     return (result);                                         \
   }                                                          \
 }
@@ -144,6 +146,32 @@ if (result == FLAG) {                                        \
   return;                                                    \
 }
 
+/*  A suffix rule of steps 2 to 4 (see stemrules.h)  */
+typedef struct stemrule {
+  unsigned int suflen;
+  unsigned int cutlen;
+  const char *newsuf;
+  unsigned int newsuflen;
+  unsigned int result;
+  unsigned int mval;
+  unsigned int st;                 /*  1 if ST (stemrules.h) is true  */
+} STEMRULE;
+
+/*  A node of the trie of reversed suffixes of a step.  Its children
+**  are the nedges edges from edge onwards; rule is the rule whose
+**  suffix ends at the node, or STEM_NORULE.  */
+#define STEM_NORULE 0xFF
+typedef struct stemtrienode {
+  unsigned short edge;
+  unsigned char nedges;
+  unsigned char rule;
+} STEMTRIENODE;
+
+typedef struct stemtrieedge {
+  unsigned char c;
+  unsigned char child;
+} STEMTRIEEDGE;
+
 unsigned int stem (unsigned char *wrd, unsigned int *wrd_len, unsigned int *m);
 unsigned int unstem (unsigned char *wrd, unsigned int len, unsigned int modifier);
 
@@ -0,0 +1,74 @@
+#ifndef STEMRULES_H
+#define STEMRULES_H
+
+/*  The suffix rules of steps 2, 3 and 4 of the stemmer, in the order
+**  in which they were originally tried.  When several rules match a
+**  word, the first one listed is used.  gen-stemtables compiles each
+**  list into a trie of reversed suffixes (stemtables.h).  The fields
+**  of STEMRULE are:
+**    SUF:     the suffix
+**    CUTLEN:  the number of bytes removed when the rule applies
+**    NEWSUF:  the string then appended ("" for none)
+**    FLAG:    the value returned (the modifier for the step)
+**    MVAL:    the rule applies only if the measure of the word before
+**             the suffix is greater than MVAL
+**    ST:      if true, the rule matches only if the suffix follows 's'
+**             or 't' (and at least one other character)  */
+
+#define STEP2_RULES \
+  STEMRULE ("ational", 5, "e", IONAL_E_2, 0, false) \
+  STEMRULE ("tional", 2, "", AL_2, 0, false) \
+  STEMRULE ("enci", 1, "e", I_E_2, 0, false) \
+  STEMRULE ("anci", 1, "e", I_E_2, 0, false) \
+  STEMRULE (EN_IZER, 1, "", R_2, 0, false) \
+  /*  Modified from the one in the original paper (abli) -- mentioned \
+  **  on Porter's web site.  */ \
+  STEMRULE ("bli", 1, "e", I_E_2, 0, false) \
+  STEMRULE ("alli", 2, "", LI_2, 0, false) \
+  STEMRULE ("entli", 2, "", LI_2, 0, false) \
+  STEMRULE ("eli", 2, "", LI_2, 0, false) \
+  STEMRULE ("ousli", 2, "", LI_2, 0, false) \
+  STEMRULE (EN_IZATION, 5, "e", IZATION_IZE_2, 0, false) \
+  STEMRULE ("ation", 3, "e", ATION_ATE_2, 0, false) \
+  STEMRULE ("ator", 2, "e", ATOR_ATE_2, 0, false) \
+  STEMRULE ("alism", 3, "", ISM_2, 0, false) \
+  STEMRULE ("iveness", 4, "", NESS_2, 0, false) \
+  STEMRULE ("fulness", 4, "", NESS_2, 0, false) \
+  STEMRULE ("ousness", 4, "", NESS_2, 0, false) \
+  STEMRULE ("aliti", 3, "", ITI_2, 0, false) \
+  STEMRULE ("iviti", 3, "e", ITI_E_2, 0, false) \
+  STEMRULE ("biliti", 5, "le", BILITI_BLE_2, 0, false) \
+  /*  Next one is new, but mentioned on Porter's web site  */ \
+  STEMRULE ("logi", 1, "", I_2, 0, false)
+
+#define STEP3_RULES \
+  STEMRULE ("icate", 3, "", ATE_3, 0, false) \
+  STEMRULE ("ative", 5, "", ATIVE_3, 0, false) \
+  STEMRULE (EN_ALIZE, 3, "", IZE_3, 0, false) \
+  STEMRULE ("iciti", 3, "", ITI_3, 0, false) \
+  STEMRULE ("ical", 2, "", AL_3, 0, false) \
+  STEMRULE ("ful", 3, "", FUL_3, 0, false) \
+  STEMRULE ("ness", 4, "", NESS_3, 0, false)
+
+#define STEP4_RULES \
+  STEMRULE ("al", 2, "", AL_4, 1, false) \
+  STEMRULE ("ance", 4, "", ANCE_4, 1, false) \
+  STEMRULE ("ence", 4, "", ENCE_4, 1, false) \
+  STEMRULE ("er", 2, "", ER_4, 1, false) \
+  STEMRULE ("ic", 2, "", IC_4, 1, false) \
+  STEMRULE ("able", 4, "", ABLE_4, 1, false) \
+  STEMRULE ("ible", 4, "", IBLE_4, 1, false) \
+  STEMRULE ("ant", 3, "", ANT_4, 1, false) \
+  STEMRULE ("ement", 5, "", EMENT_4, 1, false) \
+  STEMRULE ("ment", 4, "", MENT_4, 1, false) \
+  STEMRULE ("ent", 3, "", ENT_4, 1, false) \
+  STEMRULE ("ion", 3, "", ION_4, 1, true) \
+  STEMRULE ("ou", 2, "", OU_4, 1, false) \
+  STEMRULE ("ism", 3, "", ISM_4, 1, false) \
+  STEMRULE ("ate", 3, "", ATE_4, 1, false) \
+  STEMRULE ("iti", 3, "", ITI_4, 1, false) \
+  STEMRULE ("ous", 3, "", OUS_4, 1, false) \
+  STEMRULE ("ive", 3, "", IVE_4, 1, false) \
+  STEMRULE (EN_IZE, 3, "", IZE_4, 1, false)
+
+#endif
@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdbool.h>
+
+#include "common-def.h"
+#include "wmalloc.h"
+#include "prepair-defn.h"
+#include "casefold.h"
+#include "stem.h"
+#include "fcode.h"
+#include "word.h"
+#include "nonword.h"
+#include "prepair.h"
+#include "modseq.h"
+#include "surface.h"
+
+
+/*
+**  Write entry key of dict, with the stemming and then the
+**  case-folding modifier undone, to wrd (at least MAXWORDLEN bytes).
+**  cases holds the patterns of case (".cfx"), if there are any.
+**  Returns the length of the word.
+*/
+unsigned int renderWord (const FCODEDICT *dict, const FCODEDICT *cases, unsigned int key, unsigned int casefold_mod, unsigned int stem_mod, unsigned char *wrd) {
+  unsigned char *item = NULL;
+  unsigned char *pattern = NULL;
+  unsigned int len = 0;
+  unsigned int pattern_len = 0;
+
+  LOOKUPFCODE (dict, key, item, len);
+  memcpy (wrd, item, (size_t) len);
+  len = unstem (wrd, len, stem_mod);
+  if (casefold_mod < CASEFOLD_PATTERN) {
+    uncasefold (wrd, len, casefold_mod);
+  }
+  else if (cases != NULL) {
+    LOOKUPFCODE (cases, casefold_mod - CASEFOLD_PATTERN, pattern, pattern_len);
+    uncasefoldPattern (wrd, len, pattern, pattern_len);
+  }
+  else {
+    fprintf (stderr, "No patterns of case (.cfx) for modifier %u (%s, line %u).\n", casefold_mod, __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+
+  return (len);
+}
+
+
+/*  Allocate an empty render cache; it is released with wfree  */
+RENDERENTRY *renderCacheInit (void) {
+  RENDERENTRY *cache = wmalloc (sizeof (RENDERENTRY) * RENDER_CACHE_SIZE);
+  unsigned int i = 0;
+
+  for (i = 0; i < RENDER_CACHE_SIZE; i++) {
+    cache[i].key = EMPTY_FCODE;
+  }
+
+  return (cache);
+}
+
+
+/*  Return the cache entry holding word key of dict with the given
+**  (non-zero) modifiers undone, rendering it first on a miss  */
+const RENDERENTRY *renderCacheGet (RENDERENTRY *cache, const FCODEDICT *dict, const FCODEDICT *cases, unsigned int key, unsigned int casefold_mod, unsigned int stem_mod) {
+  RENDERENTRY *entry = &cache[SURFACEHASH (key, casefold_mod, stem_mod, RENDER_CACHE_BITS)];
+
+  if ((entry -> key != key) || (entry -> casefold != casefold_mod) || (entry -> stem != stem_mod)) {
+    entry -> len = renderWord (dict, cases, key, casefold_mod, stem_mod, entry -> text);
+    entry -> key = key;
+    entry -> casefold = casefold_mod;
+    entry -> stem = stem_mod;
+  }
+
+  return (entry);
+}
+
+
+/*  Double the number of slots of the table of triples  */
+static SURFACESLOT *growSurfaceTable (SURFACESLOT *slots, unsigned int *nslots, unsigned int *bits) {
+  SURFACESLOT *grown = NULL;
+  unsigned int mask = 0;
+  unsigned int h = 0;
+  unsigned int i = 0;
+
+  *nslots = *nslots << 1;
+  (*bits)++;
+  mask = *nslots - 1;
+  grown = wmalloc (sizeof (SURFACESLOT) * (*nslots));
+  for (i = 0; i < *nslots; i++) {
+    grown[i].id = EMPTY_FCODE;
+  }
+  for (i = 0; i < (*nslots >> 1); i++) {
+    if (slots[i].id != EMPTY_FCODE) {
+      h = SURFACEHASH (slots[i].key, slots[i].casefold, slots[i].stem, *bits);
+      while (grown[h].id != EMPTY_FCODE) {
+        h = (h + 1) & mask;
+      }
+      grown[h] = slots[i];
+    }
+  }
+  wfree (slots);
+
+  return (grown);
+}
+
+
+/*
+**  Write the surface forms (".srf") and the surface id of each record
+**  (".ss") of the files named filename, which must have been closed.
+**  The sequences are read back as a decoder would, so this works for
+**  any record width and with compacted modifiers.
+*/
+void surfaceEncode (unsigned char *filename) {
+  FILE_STRUCT file_info;
+  FCODEDICT *dict = NULL;
+  FCODEDICT *cases = NULL;
+  SURFACESLOT *slots = NULL;
+  unsigned int nslots = SURFACE_HASH_SIZE;
+  unsigned int bits = 0;
+  unsigned int nsurface = FIRST_FCODE;
+  unsigned char *pool = NULL;
+  size_t pool_len = 0;
+  size_t pool_size = INIT_FCODE_POOL_SIZE;
+  unsigned int *offset = NULL;
+  unsigned int offset_size = INIT_FCODE_SIZE;
+  FCODENODE *nodes = NULL;
+  FILE *fp = NULL;
+  unsigned int *buf = NULL;
+  unsigned int *p = NULL;
+  unsigned int key = 0;
+  unsigned int casefold_mod = 0;
+  unsigned int stem_mod = 0;
+  unsigned int h = 0;
+  unsigned int i = 0;
+  size_t j = 0;
+
+  file_info.mode = MODE_DECODE;
+  openFiles (filename, &file_info, "r", false);
+  dict = wmalloc (sizeof (FCODEDICT));
+  (void) fcodeDictDecode (&file_info, dict, ISWORD);
+  cases = loadCasePatterns (&file_info);
+  adviseSequences (&file_info, ACCESS_SEQUENTIAL);
+
+  while ((1U << bits) < nslots) {
+    bits++;
+  }
+  slots = wmalloc (sizeof (SURFACESLOT) * nslots);
+  for (i = 0; i < nslots; i++) {
+    slots[i].id = EMPTY_FCODE;
+  }
+  pool = wmalloc (sizeof (unsigned char) * pool_size);
+  offset = wmalloc (sizeof (unsigned int) * (offset_size + 1));
+  offset[0] = 0;
+  offset[FIRST_FCODE] = 0;
+
+  FOPEN (file_info.ss_name, fp, "w");
+  buf = wmalloc (sizeof (unsigned int) * OUTBUFMAX);
+  p = buf;
+
+  for (j = 0; j < file_info.nsyms; j++) {
+    key = GETSYMBOL (&file_info.ws_sym, j);
+    if (key == EMPTY_FCODE) {
+      *p = EMPTY_FCODE;
+    }
+    else {
+      casefold_mod = GETMODIFIER (&file_info.cfm_mod, j);
+      stem_mod = GETMODIFIER (&file_info.sm_mod, j);
+      h = SURFACEHASH (key, casefold_mod, stem_mod, bits);
+      while ((slots[h].id != EMPTY_FCODE) && ((slots[h].key != key) || (slots[h].casefold != casefold_mod) || (slots[h].stem != stem_mod))) {
+        h = (h + 1) & (nslots - 1);
+      }
+      if (slots[h].id == EMPTY_FCODE) {
+        /*  A new triple; its surface form is rendered onto the pool  */
+        if (pool_len + MAXWORDLEN > pool_size) {
+          pool_size = pool_size << 1;
+          pool = wrealloc (pool, sizeof (unsigned char) * pool_size);
+        }
+        if (nsurface == offset_size) {
+          offset_size = offset_size << 1;
+          offset = wrealloc (offset, sizeof (unsigned int) * (offset_size + 1));
+        }
+        pool_len += renderWord (dict, cases, key, casefold_mod, stem_mod, pool + pool_len);
+        if ((pool_len > UINT_MAX) || (nsurface == UINT_MAX)) {
+          fprintf (stderr, "Too many surface forms (%s, line %u).\n", __FILE__, __LINE__);
+          exit (EXIT_FAILURE);
+        }
+        offset[nsurface + 1] = (unsigned int) pool_len;
+        slots[h].key = key;
+        slots[h].casefold = casefold_mod;
+        slots[h].stem = stem_mod;
+        slots[h].id = nsurface;
+        nsurface++;
+        if (nsurface > (nslots >> 1)) {
+          slots = growSurfaceTable (slots, &nslots, &bits);
+        }
+        *p = nsurface - 1;
+      }
+      else {
+        *p = slots[h].id;
+      }
+    }
+    p++;
+    if (p == buf + OUTBUFMAX) {
+      (void) fwrite (buf, sizeof (unsigned int), OUTBUFMAX, fp);
+      p = buf;
+    }
+  }
+  if (p != buf) {
+    (void) fwrite (buf, sizeof (unsigned int), (size_t) (p - buf), fp);
+  }
+  if (fclose (fp) != 0) {
+    fprintf (stderr, "Error writing %s (%s, line %u).\n", file_info.ss_name, __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
+
+  nodes = wmalloc (sizeof (FCODENODE) * nsurface);
+  for (i = FIRST_FCODE; i < nsurface; i++) {
+    nodes[i].item = pool + offset[i];
+    nodes[i].len = offset[i + 1] - offset[i];
+  }
+  fcodeFlatDictWrite (file_info.srf_name, nodes, nsurface);
+
+  wfree (nodes);
+  wfree (buf);
+  wfree (offset);
+  wfree (pool);
+  wfree (slots);
+  if (cases != NULL) {
+    fcodeDictFree (cases);
+  }
+  fcodeDictFree (dict);
+  closeFilesDecode (&file_info, NULL, NULL);
+
+  return;
+}
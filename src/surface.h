@@ -0,0 +1,52 @@
+#ifndef SURFACE_H
+#define SURFACE_H
+
+/*  With -S, encoding also writes the surface form of each word as it
+**  appeared in the text.  Each distinct (word id, case-folding
+**  modifier, stemming modifier) triple of the records is given a
+**  surface id, in the order first seen, with 0 for the zero-length
+**  word.  The surface forms are written to ".srf" as a flat dictionary
+**  (see fcode.h), unsorted and indexed by surface id, and the surface
+**  id of each record to ".ss", as a plain array of unsigned ints.  A
+**  decoder which finds both writes each word straight from ".srf",
+**  without unstemming or un-case-folding it; the other files are
+**  left as they are.  */
+
+/*  Initial number of slots in the table of triples; must be a power
+**  of 2.  It is doubled whenever it becomes half full.  */
+#define SURFACE_HASH_SIZE 65536
+
+/*  Words with modifiers are otherwise rendered through a cache of
+**  (1 << RENDER_CACHE_BITS) entries, indexed by a hash of the triple.
+**  A new triple replaces the one in its entry.  */
+#define RENDER_CACHE_BITS 12
+#define RENDER_CACHE_SIZE (1U << RENDER_CACHE_BITS)
+
+/*  The hash of a triple, of BITS bits  */
+#define SURFACEHASH(KEY,CASEFOLD,STEM,BITS) \
+  ((((KEY) * 0x9E3779B1U) ^ ((CASEFOLD) * 0x85EBCA77U) ^ ((STEM) * 0xC2B2AE3DU)) >> (32 - (BITS)))
+
+/*  A rendered word in the cache.  A key of EMPTY_FCODE marks an
+**  unused entry, since zero-length words are never rendered.  */
+typedef struct renderentry {
+  unsigned int key;
+  unsigned int casefold;
+  unsigned int stem;
+  unsigned int len;
+  unsigned char text[MAXWORDLEN];
+} RENDERENTRY;
+
+/*  A slot of the table of triples, used while encoding  */
+typedef struct surfaceslot {
+  unsigned int key;
+  unsigned int casefold;
+  unsigned int stem;
+  unsigned int id;                          /*  EMPTY_FCODE if unused  */
+} SURFACESLOT;
+
+unsigned int renderWord (const FCODEDICT *dict, const FCODEDICT *cases, unsigned int key, unsigned int casefold_mod, unsigned int stem_mod, unsigned char *wrd);
+RENDERENTRY *renderCacheInit (void);
+const RENDERENTRY *renderCacheGet (RENDERENTRY *cache, const FCODEDICT *dict, const FCODEDICT *cases, unsigned int key, unsigned int casefold_mod, unsigned int stem_mod);
+void surfaceEncode (unsigned char *filename);
+
+#endif
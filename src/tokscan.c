@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#if defined (__AVX2__) || defined (__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "common-def.h"
+#include "prepair-defn.h"
+#include "tokscan.h"
+
+/*  The class of every byte.  The program never calls setlocale (), so
+**  isalnum () follows the "C" locale and this table matches it.  */
+#define W TOK_WORD
+#define T TOK_TAG
+const unsigned char tok_class[256] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, W,      /*  '/'  */
+  W, W, W, W, W, W, W, W, W, W, 0, 0, T, 0, T, 0,      /*  0-9, '<', '>'  */
+  0, W, W, W, W, W, W, W, W, W, W, W, W, W, W, W,      /*  A-O  */
+  W, W, W, W, W, W, W, W, W, W, W, 0, 0, 0, 0, 0,      /*  P-Z  */
+  0, W, W, W, W, W, W, W, W, W, W, W, W, W, W, W,      /*  a-o  */
+  W, W, W, W, W, W, W, W, W, W, W, 0, 0, 0, 0, 0,      /*  p-z  */
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+#undef W
+#undef T
+
+
+/*
+**  Vector classification.  A byte is TOK_WORD if it is a digit, a
+**  letter (once 0x20 is set, only 'A'-'Z' and 'a'-'z' fall in
+**  'a'-'z') or '/'.  Ranges are tested with signed compares after
+**  adding 0x80, which turns the unsigned bytes into ordered signed
+**  ones.  The masks have bit i set if byte i is of the class.
+*/
+#if defined (__AVX2__)
+#define TOK_VECLEN 32
+typedef __m256i TOK_VEC;
+#define TOK_LOAD(P) _mm256_loadu_si256 ((const __m256i*) (P))
+#define TOK_SET1(C) _mm256_set1_epi8 ((char) (C))
+#define TOK_OR(A,B) _mm256_or_si256 (A, B)
+#define TOK_AND(A,B) _mm256_and_si256 (A, B)
+#define TOK_EQ(A,B) _mm256_cmpeq_epi8 (A, B)
+#define TOK_GT(A,B) _mm256_cmpgt_epi8 (A, B)
+#define TOK_XOR(A,B) _mm256_xor_si256 (A, B)
+#define TOK_MASK(A) ((unsigned int) _mm256_movemask_epi8 (A))
+#elif defined (__SSE2__)
+#define TOK_VECLEN 16
+typedef __m128i TOK_VEC;
+#define TOK_LOAD(P) _mm_loadu_si128 ((const __m128i*) (P))
+#define TOK_SET1(C) _mm_set1_epi8 ((char) (C))
+#define TOK_OR(A,B) _mm_or_si128 (A, B)
+#define TOK_AND(A,B) _mm_and_si128 (A, B)
+#define TOK_EQ(A,B) _mm_cmpeq_epi8 (A, B)
+#define TOK_GT(A,B) _mm_cmpgt_epi8 (A, B)
+#define TOK_XOR(A,B) _mm_xor_si128 (A, B)
+#define TOK_MASK(A) ((unsigned int) _mm_movemask_epi8 (A))
+#endif
+
+#ifdef TOK_VECLEN
+/*  Bytes of X (already offset by 0x80) in [LO, HI]  */
+#define TOK_RANGE(X,LO,HI) \
+  TOK_AND (TOK_GT (X, TOK_SET1 ((LO) - 1 + 0x80)), TOK_GT (TOK_SET1 ((HI) + 1 + 0x80), X))
+
+static unsigned int wordMask (const unsigned char *p, bool tags) {
+  TOK_VEC raw = TOK_LOAD (p);
+  TOK_VEC x = TOK_XOR (raw, TOK_SET1 (0x80));
+  TOK_VEC lower = TOK_XOR (TOK_OR (raw, TOK_SET1 (0x20)), TOK_SET1 (0x80));
+  TOK_VEC m;
+
+  m = TOK_OR (TOK_RANGE (x, '0', '9'), TOK_RANGE (lower, 'a', 'z'));
+  m = TOK_OR (m, TOK_EQ (raw, TOK_SET1 ('/')));
+  if (tags == true) {
+    m = TOK_OR (m, TOK_EQ (raw, TOK_SET1 ('<')));
+    m = TOK_OR (m, TOK_EQ (raw, TOK_SET1 ('>')));
+  }
+
+  return (TOK_MASK (m));
+}
+#endif
+
+
+/*
+**  Return the number of bytes from p (at most lim, and not past end)
+**  which are TOK_WORD.
+*/
+size_t scanWordRun (const unsigned char *p, const unsigned char *end, size_t lim) {
+  size_t n = 0;
+#ifdef TOK_VECLEN
+  unsigned int mask = 0;
+
+  while ((n + TOK_VECLEN <= lim) && (p + n + TOK_VECLEN <= end)) {
+    mask = ~wordMask (p + n, false);
+    if (mask != 0) {
+      return (n + (size_t) __builtin_ctz (mask));
+    }
+    n += TOK_VECLEN;
+  }
+#endif
+
+  while ((n < lim) && (p + n < end) && (tok_class[p[n]] == TOK_WORD)) {
+    n++;
+  }
+
+  return (n);
+}
+
+
+/*
+**  Return the number of bytes from p (at most lim, and not past end)
+**  which are TOK_NONWORD.
+*/
+size_t scanNonWordRun (const unsigned char *p, const unsigned char *end, size_t lim) {
+  size_t n = 0;
+#ifdef TOK_VECLEN
+  unsigned int mask = 0;
+
+  while ((n + TOK_VECLEN <= lim) && (p + n + TOK_VECLEN <= end)) {
+    mask = wordMask (p + n, true);
+    if (mask != 0) {
+      return (n + (size_t) __builtin_ctz (mask));
+    }
+    n += TOK_VECLEN;
+  }
+#endif
+
+  while ((n < lim) && (p + n < end) && (tok_class[p[n]] == TOK_NONWORD)) {
+    n++;
+  }
+
+  return (n);
+}
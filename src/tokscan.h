@@ -0,0 +1,12 @@
+#ifndef TOKSCAN_H
+#define TOKSCAN_H
+
+/*  Classes of bytes used by the tokenizer (see tok_class)  */
+#define TOK_NONWORD 0               /*  Not part of a word  */
+#define TOK_WORD 1                  /*  Letters, digits and '/'  */
+#define TOK_TAG 2                   /*  '<' and '>', which end or split words  */
+
+size_t scanWordRun (const unsigned char *p, const unsigned char *end, size_t lim);
+size_t scanNonWordRun (const unsigned char *p, const unsigned char *end, size_t lim);
+
+#endif
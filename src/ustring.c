@@ -59,11 +59,7 @@ void ustrncat (unsigned char *s, unsigned char *t, unsigned int n) {
 
 
 void uprintf (FILE *fp, unsigned char *wrd, unsigned int wrd_len) {
-  unsigned int i = 0;
-
-  for (i = 0; i < wrd_len; i++) {
-    (void) putc ((int) wrd[i], fp);
-  }
+  (void) fwrite (wrd, sizeof (unsigned char), (size_t) wrd_len, fp);
 
   return;
 }
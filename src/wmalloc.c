@@ -13,14 +13,21 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef COUNT_MALLOC
+#include <pthread.h>
+#endif
 
 #include "common-def.h"
 #include "wmalloc.h"
 
-static unsigned int inuse_malloc = 0;
-static unsigned int max_malloc = 0;
+static size_t inuse_malloc = 0;
+static size_t max_malloc = 0;
 static WMSTRUCT **wm_array;
 static char *tempstr;
+#ifdef COUNT_MALLOC
+/*  Threads allocate concurrently when encoding with -t  */
+static pthread_mutex_t wm_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
 
 void *wmalloc (size_t y_arg) {
   void *x_arg = malloc (y_arg);
@@ -60,6 +67,75 @@ void wfree (void *x_arg) {
   free (x_arg);
 }
 
+/*
+**  Create an empty arena whose blocks hold block_size bytes (more
+**  for a single allocation that does not fit).  No block is allocated
+**  until the first allocation.
+*/
+WMARENA *wmArenaInit (size_t block_size) {
+  WMARENA *arena = wmalloc (sizeof (WMARENA));
+
+  arena -> head = NULL;
+  arena -> block_size = block_size;
+  arena -> total = 0;
+
+  return (arena);
+}
+
+
+/*
+**  Allocate size bytes from the arena, aligned to align bytes (a power
+**  of 2).  The memory is only released by wmArenaFree.
+*/
+void *wmArenaAlloc (WMARENA *arena, size_t size, size_t align) {
+  WMARENABLOCK *block = arena -> head;
+  unsigned char *data = NULL;
+  size_t pad = 0;
+  size_t block_size = 0;
+
+  if (block != NULL) {
+    data = (unsigned char*) (block + 1);
+    pad = (align - (((size_t) (data + block -> used)) & (align - 1))) & (align - 1);
+  }
+
+  if ((block == NULL) || (block -> used + pad + size > block -> size)) {
+    block_size = arena -> block_size;
+    if (size + align > block_size) {
+      block_size = size + align;
+    }
+    block = wmalloc (sizeof (WMARENABLOCK) + block_size);
+    block -> next = arena -> head;
+    block -> size = block_size;
+    block -> used = 0;
+    arena -> head = block;
+    data = (unsigned char*) (block + 1);
+    pad = (align - (((size_t) data) & (align - 1))) & (align - 1);
+  }
+
+  data = data + block -> used + pad;
+  block -> used += pad + size;
+  arena -> total += size;
+
+  return ((void*) data);
+}
+
+
+/*  Release the arena and everything allocated from it  */
+void wmArenaFree (WMARENA *arena) {
+  WMARENABLOCK *block = arena -> head;
+  WMARENABLOCK *next = NULL;
+
+  while (block != NULL) {
+    next = block -> next;
+    wfree (block);
+    block = next;
+  }
+  wfree (arena);
+
+  return;
+}
+
+
 /*
 **  Function adapted from Algorithms in C (Third edition) by Robert Sedgewick
 **  (page 578)
@@ -84,12 +160,21 @@ void initWMalloc () {
   inuse_malloc = 0;
   max_malloc = 0;
 
-  tempstr = wmalloc (sizeof (char) * TEMPSTRLEN);
-
-  wm_array = wmalloc (sizeof (WMSTRUCT*) * WM_SIZE);
+  /*  The bookkeeping itself is not counted, so it is allocated with
+  **  malloc rather than wmalloc  */
+  tempstr = malloc (sizeof (char) * TEMPSTRLEN);
+  wm_array = malloc (sizeof (WMSTRUCT*) * WM_SIZE);
+  if ((tempstr == NULL) || (wm_array == NULL)) {
+    fprintf (stderr, "Error in malloc while initialising the allocation counts in [%s, %u].\n", __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
   for (i = 0; i < WM_SIZE; i++) {
     /*  Add sentinel  */
-    node = wmalloc (sizeof (WMSTRUCT));
+    node = malloc (sizeof (WMSTRUCT));
+    if (node == NULL) {
+      fprintf (stderr, "Error in malloc while initialising the allocation counts in [%s, %u].\n", __FILE__, __LINE__);
+      exit (EXIT_FAILURE);
+    }
     node -> ptr = NULL;
     node -> size = 0;
     node -> file = NULL;
@@ -103,14 +188,21 @@ void initWMalloc () {
 
 
 void printWMalloc () {
-  fprintf (stderr, "\tMemory used at exit:  %u\n", inuse_malloc);
-  fprintf (stderr, "\tMaximum memory used at once:  %u\n", max_malloc);
+  fprintf (stderr, "\tMemory used at exit:  %zu\n", inuse_malloc);
+  fprintf (stderr, "\tMaximum memory used at once:  %zu\n", max_malloc);
   fprintf (stderr, "\tMaximum memory (MB):  %.1f\n", (double) max_malloc / (double) (1024 * 1024));
 
   return;
 }
 
 
+/*  The most memory in use at once so far (only counted with
+**  COUNT_MALLOC)  */
+size_t peakWMalloc (void) {
+  return (max_malloc);
+}
+
+
 void printInUseWMalloc (void) {
   unsigned int i = 0;
   WMSTRUCT *curr = NULL;
@@ -133,13 +225,23 @@ void countMalloc (void *ptr, size_t amount, const char *file, const unsigned int
   WMSTRUCT *node = NULL;
   unsigned int pos = 0;
 
-  node = wmalloc (sizeof (WMSTRUCT));
+  /*  Nodes are freed with free in countFree  */
+  node = malloc (sizeof (WMSTRUCT));
+  if (node != NULL) {
+    node -> file = malloc (sizeof (char) * (strlen (file) + 1));
+  }
+  if ((node == NULL) || (node -> file == NULL)) {
+    fprintf (stderr, "Error in malloc while counting an allocation in [%s, %u].\n", __FILE__, __LINE__);
+    exit (EXIT_FAILURE);
+  }
   node -> ptr = ptr;
   node -> size = amount;
-  node -> file = wmalloc (sizeof (char) * (strlen (file) + 1));
   node -> file = strcpy (node -> file, file);
   node -> line = line;
 
+#ifdef COUNT_MALLOC
+  pthread_mutex_lock (&wm_lock);
+#endif
   (void) snprintf (tempstr, TEMPSTRLEN, "%p", ptr);
   pos = hash (tempstr, WM_SIZE);
   node -> next = wm_array[pos];
@@ -150,6 +252,9 @@ void countMalloc (void *ptr, size_t amount, const char *file, const unsigned int
   if (inuse_malloc > max_malloc) {
     max_malloc = inuse_malloc;
   }
+#ifdef COUNT_MALLOC
+  pthread_mutex_unlock (&wm_lock);
+#endif
 
   return;
 }
@@ -160,6 +265,14 @@ void countFree (void *ptr) {
   WMSTRUCT *curr = NULL;
   unsigned int pos = 0;
 
+  /*  As with free, a NULL pointer is ignored  */
+  if (ptr == NULL) {
+    return;
+  }
+
+#ifdef COUNT_MALLOC
+  pthread_mutex_lock (&wm_lock);
+#endif
   (void) snprintf (tempstr, TEMPSTRLEN, "%p", ptr);
   pos = hash (tempstr, WM_SIZE);
 
@@ -190,6 +303,9 @@ void countFree (void *ptr) {
   else {
     prev -> next = curr -> next;
   }
+#ifdef COUNT_MALLOC
+  pthread_mutex_unlock (&wm_lock);
+#endif
   free (curr -> file);
   free (curr);
 
@@ -16,6 +16,9 @@
 #define WM_SIZE 65536
 #define TEMPSTRLEN 80
 
+/*  Default size of the blocks of an arena  */
+#define WM_ARENA_BLOCK 1048576
+
 typedef struct wmstruct {
   void *ptr;
   size_t size;
@@ -24,13 +27,36 @@ typedef struct wmstruct {
   struct wmstruct *next;
 } WMSTRUCT;
 
+
+/*  A block of an arena; its data follows the header  */
+typedef struct wmarenablock {
+  struct wmarenablock *next;
+  size_t size;                          /*  Bytes of data in the block  */
+  size_t used;
+} WMARENABLOCK;
+
+
+/*  A bump-pointer arena for many small allocations which are all
+**  released together.  The blocks are obtained with wmalloc, so they
+**  are accounted for with COUNT_MALLOC.  */
+typedef struct wmarena {
+  WMARENABLOCK *head;            /*  Block being filled; older ones follow  */
+  size_t block_size;
+  size_t total;                  /*  Bytes handed out  */
+} WMARENA;
+
 void *wmalloc (size_t y_arg);
 void *wrealloc (void *x_arg, size_t y_arg);
 void wfree (void *x_arg);
 
+WMARENA *wmArenaInit (size_t block_size);
+void *wmArenaAlloc (WMARENA *arena, size_t size, size_t align);
+void wmArenaFree (WMARENA *arena);
+
 void initWMalloc (void);
 void printWMalloc (void);
 void printInUseWMalloc (void);
+size_t peakWMalloc (void);
 void countMalloc (void *ptr, size_t amount, const char *file, unsigned int line);
 void countFree (void *ptr);
 
@@ -1,22 +1,26 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <string.h>
 #include <stdbool.h>
 
 #include "common-def.h"
+#include "wmalloc.h"
 #include "prepair-defn.h"
 #include "fcode.h"
 #include "word.h"
+#include "tokscan.h"
 
 
 /* Read the next word from the indicated stream. Returns EOF if no word
 ** can be found; returns positive if a word is found. At most `lim'
 ** characters will be read into array w.  */
-unsigned int getWord (unsigned char **src_p, unsigned char *src_end, unsigned char *w, unsigned int lim, bool *notdone, unsigned int *long_tokens, unsigned int *enforce_tags) {
+unsigned int getWord (unsigned char **src_p, unsigned char *src_end, unsigned char *w, unsigned int lim, bool *notdone, unsigned long long *long_tokens, unsigned long long *enforce_tags) {
   unsigned int len = 0;
   unsigned int c = 0;
   unsigned int d = 0;
   unsigned int e = 0;
+  size_t run = 0;
 
   *notdone = false;
   do {
@@ -24,6 +28,21 @@ unsigned int getWord (unsigned char **src_p, unsigned char *src_end, unsigned ch
       *notdone = true;
       break;
     }
+
+    /*  Copy a run of ordinary word characters at once; the rules below
+    **  are only needed for the character which ends the run  */
+    run = scanWordRun (*src_p, src_end, (size_t) (lim - len));
+    if (run != 0) {
+      memcpy (w, *src_p, run);
+      w += run;
+      *src_p += run;
+      len += (unsigned int) run;
+      if (*src_p == src_end) {
+        *notdone = true;
+        break;
+      }
+    }
+
     c = (unsigned int) **src_p;
     /*  If c isn't a word but is an apostrophe, then check the following
     **  two letters.  If the next letter is either a d, m, s, or t and
@@ -1,6 +1,27 @@
 #ifndef WORD_H
 #define WORD_H
 
+/*  Initial number of entries in the stem cache  */
+#define INIT_STEMCACHE_SIZE 65536
+
+/*  What case-folding, stemming and the lexicon made of one surface
+**  form of a word  */
+typedef struct stemcacheentry {
+  unsigned int key;                            /*  Id in the lexicon  */
+  unsigned int casefold;                 /*  Case-folding modifier  */
+  unsigned int stem;                         /*  Stemming modifier  */
+  unsigned int len;                  /*  Length after stemming  */
+} STEMCACHEENTRY;
+
+/*  Distinct surface forms (as read from the text) and their entries,
+**  so that each is case-folded and stemmed only once  */
+typedef struct stemcache {
+  FCODEHASH *surface;
+  unsigned int nsurface;             /*  Next id to give a surface form  */
+  STEMCACHEENTRY *entries;
+  unsigned int size;                   /*  Number of entries allocated  */
+} STEMCACHE;
+
 
 typedef struct wordstruct {
   /*  General settings  */
@@ -9,26 +30,48 @@ typedef struct wordstruct {
   bool dostem;                                  /*  Stem words  */
 
   unsigned int nwords;                                /*  Number of words  */
-  unsigned int total_words_len;        /*  Length of all words in lexicon  */
+  unsigned long long total_words_len;  /*  Length of all words in lexicon  */
   unsigned int nwords_prims;     /*  Number of words which are in Latin-1  */
-  unsigned int cmps;               /*  Number of splay tree nodes visited  */
+  unsigned long long cmps;         /*  Number of splay tree nodes visited  */
   unsigned int *map;           /*  Map used to re-encode sequence symbols  */
 
   /*  Statistics about parsing  */
-  unsigned int total_tokens;
-  unsigned int total_length;
-  unsigned int long_tokens;
-  unsigned int enforce_tags;
-  unsigned int zerolength_sym;
+  unsigned long long total_tokens;
+  unsigned long long total_length;
+  unsigned long long long_tokens;
+  unsigned long long enforce_tags;
+  unsigned long long zerolength_sym;
+  unsigned long long cache_hits; /*  Words found in the stem cache  */
+  unsigned long long cache_cmps;   /*  Comparisons probing the stem cache  */
+
+  /*  Time spent in each phase of parsing, in nanoseconds, over the
+  **  records sampled so far (only if sample_phases is set)  */
+  bool sample_phases;
+  unsigned int sample_countdown;
+  unsigned long long sampled;
+  unsigned long long sample_ns[NUM_PARSE_PHASES];
+  unsigned long long sample_marks[NUM_PARSE_PHASES];  /*  Clock readings  */
 
   /*  Front-coding words  */
   FCODETREE *root_fc;
+  FCODEHASH *hash_fc;          /*  Hash lexicon, used instead of root_fc  */
   FCODENODE *dict_fc;
+  FCODEDICT *pool_fc;             /*  Dictionary loaded for decoding  */
+  FCODEDICT *surface_fc;   /*  Surface forms (.srf) loaded for decoding  */
+  WMARENA *arena_fc;                /*  Nodes and items of root_fc  */
   bool printsorted;            /*  Print words in sorted order  */
+
+  STEMCACHE *stem_cache;  /*  Only with the hash lexicon and -c or -s  */
+
+  /*  Patterns of case of words beyond the case-folding mask (see
+  **  casefold.h), given ids from FIRST_FCODE in the order first seen  */
+  FCODEHASH *case_hash;                          /*  Only with -c  */
+  unsigned int ncases;                /*  Next id to give a pattern  */
+  FCODEDICT *case_fc;       /*  Patterns (.cfx) loaded for decoding  */
 } WORD_STRUCT;
 
 
-unsigned int getWord (unsigned char **src_p, unsigned char *src_end, unsigned char *w, unsigned int lim, bool *notdone, unsigned int *long_tokens, unsigned int *enforce_tags);
+unsigned int getWord (unsigned char **src_p, unsigned char *src_end, unsigned char *w, unsigned int lim, bool *notdone, unsigned long long *long_tokens, unsigned long long *enforce_tags);
 
 #endif
 